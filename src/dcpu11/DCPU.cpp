@@ -13,6 +13,7 @@ namespace dcpu11
     void DCPU::setMemory(u16 addr, u16 val)
     {
         m_ram[addr] = val;
+        onStore(m_ram + addr);
     }
 
     void DCPU::setMemory(const u16 ram[DCPU_RAM_SIZE])
@@ -20,7 +21,57 @@ namespace dcpu11
         // TODO back to memcpy
         //memcpy(m_ram, ram, DCPU_RAM_SIZE * sizeof(u16));
         for(u32 i = 0; i < DCPU_RAM_SIZE; i++)
+        {
             m_ram[i] = ram[i];
+            onStore(m_ram + i);
+        }
+    }
+
+    void DCPU::mapMemory(IMemoryObserver * observer, u16 first, u32 size)
+    {
+        if(size == 0)
+            return;
+
+        MemoryRange r;
+        r.first = first;
+        r.end = first + size;
+        if(r.end > DCPU_RAM_SIZE)
+            r.end = DCPU_RAM_SIZE;
+        r.observer = observer;
+
+        m_mappedRanges.push_back(r);
+        countMappedPages(r, 1);
+    }
+
+    void DCPU::unmapMemory(IMemoryObserver * observer)
+    {
+        u32 n = 0;
+        for(u32 i = 0; i < m_mappedRanges.size(); i++)
+        {
+            if(m_mappedRanges[i].observer != observer)
+                m_mappedRanges[n++] = m_mappedRanges[i];
+            else
+                countMappedPages(m_mappedRanges[i], -1);
+        }
+        m_mappedRanges.resize(n);
+    }
+
+    void DCPU::notifyObservers(u16 addr)
+    {
+        // The page is mapped, but maybe not this word
+        for(u32 i = 0; i < m_mappedRanges.size(); i++)
+        {
+            const MemoryRange & r = m_mappedRanges[i];
+            if(addr >= r.first && addr < r.end)
+                r.observer->onMemoryWrite(addr, m_ram[addr]);
+        }
+    }
+
+    void DCPU::countMappedPages(const MemoryRange & r, int n)
+    {
+        const u32 lastPage = (r.end - 1) >> DCPU_PAGE_SHIFT;
+        for(u32 p = r.first >> DCPU_PAGE_SHIFT; p <= lastPage; p++)
+            m_mappedPages[p] += n;
     }
 
     static u16 lit[0x20] = {
@@ -238,7 +289,10 @@ namespace dcpu11
         }
 
         if(a_code < 0x1f)
+        {
             *a_addr = res;
+            onStore(a_addr);
+        }
 
         m_cycles += opCost[opcode];
     }
@@ -254,6 +308,7 @@ namespace dcpu11
         {
         case EOP_JSR:
             m_ram[--m_sp] = m_pc;
+            onStore(m_ram + m_sp);
             m_pc = a;
             return;
 
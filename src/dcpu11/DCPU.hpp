@@ -12,6 +12,7 @@
 
 #include <string.h> // for memset
 #include <iostream>
+#include <vector>
 
 // Enable debug messages
 // 1 : on
@@ -21,6 +22,10 @@
 #define DCPU_REG_COUNT 8
 #define DCPU_RAM_SIZE 65536
 
+// Granularity of memory-mapped flags (256 words per page)
+#define DCPU_PAGE_SHIFT 8
+#define DCPU_PAGE_COUNT (DCPU_RAM_SIZE >> DCPU_PAGE_SHIFT)
+
 typedef unsigned long u32;
 typedef unsigned short u16;
 typedef unsigned char u8;
@@ -154,10 +159,30 @@ namespace dcpu11
     }
 
 
+    // Something that reacts when a DCPU memory word is written
+    // (memory-mapped devices)
+    class IMemoryObserver
+    {
+    public :
+
+        virtual ~IMemoryObserver() {}
+
+        // Called after value has been stored at addr
+        virtual void onMemoryWrite(u16 addr, u16 value) = 0;
+    };
+
     class DCPU
     {
     private :
 
+        // Address range mapped by a device
+        struct MemoryRange
+        {
+            u32 first;
+            u32 end;
+            IMemoryObserver * observer;
+        };
+
         u16 m_ram[DCPU_RAM_SIZE];   // Memory
         u16 m_r[8];         // Registers
         u16 m_sp;           // Stack pointer
@@ -166,6 +191,9 @@ namespace dcpu11
         u32 m_steps;        // Number of steps
         u32 m_cycles;       // Number of cycles
 
+        std::vector<MemoryRange> m_mappedRanges;
+        u16 m_mappedPages[DCPU_PAGE_COUNT]; // Number of ranges touching each page
+
     public :
 
         // Constructs a DCPU with all memories set to zero
@@ -178,6 +206,7 @@ namespace dcpu11
             m_ov = 0;
             m_steps = 0;
             m_cycles = 0;
+            memset(m_mappedPages, 0, DCPU_PAGE_COUNT * sizeof(u16));
         }
 
         // Executes one instruction
@@ -188,6 +217,13 @@ namespace dcpu11
         void setMemory(u16 addr, u16 val);
         void setMemory(const u16 ram[DCPU_RAM_SIZE]);
 
+        // Memory-mapped I/O : observer is called for each store
+        // in [first, first + size[. Reads always go to RAM.
+        void mapMemory(IMemoryObserver * observer, u16 first, u32 size);
+
+        // Removes all ranges mapped by observer
+        void unmapMemory(IMemoryObserver * observer);
+
         u16 getRegister(u8 i) const { return m_r[i]; }
 
         u16 getSP() const { return m_sp; }
@@ -204,6 +240,20 @@ namespace dcpu11
         // Evaluates next operand
         u16 * operand(u16 code);
 
+        // Calls observers if p is a word of a mapped page.
+        // Only stores are checked, so unmapped memory stays plain RAM.
+        void onStore(const u16 * p)
+        {
+            if(p >= m_ram && p < m_ram + DCPU_RAM_SIZE
+            && m_mappedPages[(p - m_ram) >> DCPU_PAGE_SHIFT] != 0)
+                notifyObservers(p - m_ram);
+        }
+
+        void notifyObservers(u16 addr);
+
+        // Adds n to the ranges count of the pages touched by r
+        void countMappedPages(const MemoryRange & r, int n);
+
         // Skips one instruction
         void skip();
 
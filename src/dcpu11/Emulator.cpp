@@ -67,7 +67,14 @@ namespace dcpu11
     {
         std::cout << "Running emulator..." << std::endl;
 
-        m_tileSprite.SetImage(m_charset);
+        // The screen is redrawn where the program writes to VRAM,
+        // instead of scanning it every frame
+        m_screen.Create(DCPU_SCREEN_W, DCPU_SCREEN_H, sf::Color(0,0,0));
+        m_screen.SetSmooth(false);
+        m_screenSprite.SetImage(m_screen);
+        memset(m_dirtyTiles, 0xff, sizeof(m_dirtyTiles));
+        m_screenDirty = true;
+        m_dcpu.mapMemory(this, m_vramAddr, DCPU11_SCREEN_TILES);
 
         // Video mode
         int ratio = 4;
@@ -128,6 +135,8 @@ namespace dcpu11
             m_win->Display();
         }
 
+        m_dcpu.unmapMemory(this);
+
         // Delete window
         if(m_win != 0)
         {
@@ -144,59 +153,73 @@ namespace dcpu11
             m_dcpu.step();
     }
 
+    void Emulator::onMemoryWrite(u16 addr, u16 value)
+    {
+        const u16 i = addr - m_vramAddr;
+        m_dirtyTiles[i / 32] |= (u32)1 << (i % 32);
+        m_screenDirty = true;
+    }
+
     // draws the screen from video RAM
     void Emulator::drawScreen()
     {
-        u16 x, y, addr = DCPU11_VRAM_START;
-        sf::IntRect subRect;
-
-        for(y = 0; y < DCPU_NTILES_Y; y++)
-        for(x = 0; x < DCPU_NTILES_X; x++, addr++)
+        if(m_screenDirty)
         {
-            u16 word = m_dcpu.getMemory(addr);
-            u8 c = word & 0x007f;
-            //bool blink = (word & 0x0080) != 0; // TODO handle blink
-            //TODO handle back color
-            u8 format = ((word & 0xff00) >> 8) & 0x00ff;
-            bool bright = (format & 0b10000000) != 0;
-
-            sf::Color clr;
-            if(format & 0b01000000) // ForeRed
+            u16 x, y, i = 0;
+            for(y = 0; y < DCPU_NTILES_Y; y++)
+            for(x = 0; x < DCPU_NTILES_X; x++, i++)
             {
-                clr.r = 128;
-                if(bright)
-                    clr.r += 127;
-            }
-            if(format & 0b00100000) // ForeGreen
-            {
-                clr.g = 128;
-                if(bright)
-                    clr.g += 127;
-            }
-            if(format & 0b00010000) // ForeBlue
-            {
-                clr.b = 128;
-                if(bright)
-                    clr.b += 127;
+                if(m_dirtyTiles[i / 32] & ((u32)1 << (i % 32)))
+                    drawTile(x, y, m_dcpu.getMemory(m_vramAddr + i));
             }
+            memset(m_dirtyTiles, 0, sizeof(m_dirtyTiles));
+            m_screenDirty = false;
+        }
 
-            if(clr.r || clr.g || clr.b)
-            {
-                // Charset position
-                u16 cx = DCPU_TILE_W * (c % 32);
-                u16 cy = DCPU_TILE_H * (c / 32);
+        m_win->Draw(m_screenSprite);
+    }
 
-                subRect.Left = cx;
-                subRect.Top = cy;
-                subRect.Right = cx + DCPU_TILE_W;
-                subRect.Bottom = cy + DCPU_TILE_H;
+    void Emulator::drawTile(u16 x, u16 y, u16 word)
+    {
+        u8 c = word & 0x007f;
+        //bool blink = (word & 0x0080) != 0; // TODO handle blink
+        //TODO handle back color
+        u8 format = ((word & 0xff00) >> 8) & 0x00ff;
+        bool bright = (format & 0b10000000) != 0;
+
+        sf::Color clr;
+        if(format & 0b01000000) // ForeRed
+        {
+            clr.r = 128;
+            if(bright)
+                clr.r += 127;
+        }
+        if(format & 0b00100000) // ForeGreen
+        {
+            clr.g = 128;
+            if(bright)
+                clr.g += 127;
+        }
+        if(format & 0b00010000) // ForeBlue
+        {
+            clr.b = 128;
+            if(bright)
+                clr.b += 127;
+        }
 
-                m_tileSprite.SetSubRect(subRect);
-                m_tileSprite.SetPosition(x * DCPU_TILE_W, y * DCPU_TILE_H);
-                m_tileSprite.SetColor(clr);
+        // Charset position
+        u16 cx = DCPU_TILE_W * (c % 32);
+        u16 cy = DCPU_TILE_H * (c / 32);
 
-                m_win->Draw(m_tileSprite);
-            }
+        // Glyph tinted by the color, over black
+        for(u16 j = 0; j < DCPU_TILE_H; j++)
+        for(u16 i = 0; i < DCPU_TILE_W; i++)
+        {
+            const sf::Color g = m_charset.GetPixel(cx + i, cy + j);
+            m_screen.SetPixel(x * DCPU_TILE_W + i, y * DCPU_TILE_H + j, sf::Color(
+                g.r * clr.r / 255 * g.a / 255,
+                g.g * clr.g / 255 * g.a / 255,
+                g.b * clr.b / 255 * g.a / 255));
         }
     }
 
@@ -7,6 +7,7 @@
 
 #define DCPU11_VRAM_START 0x8000 // Video
 #define DCPU11_KBRAM_START 0x9000 // Keyboard
+#define DCPU11_SCREEN_TILES 384 // 32x12 tiles, one VRAM word each
 
 /*
     DCPU emulator window
@@ -14,7 +15,7 @@
 
 namespace dcpu11
 {
-    class Emulator
+    class Emulator : public IMemoryObserver
     {
     private :
 
@@ -32,8 +33,11 @@ namespace dcpu11
 
         // LEM1802
         sf::Image m_charset;        // Character glyphs
-        sf::Sprite m_tileSprite;    // Sprite used to draw screen's tiles
+        sf::Image m_screen;         // Screen pixels, only redrawn where VRAM is written
+        sf::Sprite m_screenSprite;  // Sprite used to draw the screen
         u16 m_vramAddr;             // Adress of VRAM in the DCPU16 RAM
+        u32 m_dirtyTiles[DCPU11_SCREEN_TILES / 32]; // Tiles written since the last draw
+        bool m_screenDirty;
 
     public :
 
@@ -42,6 +46,8 @@ namespace dcpu11
         {
             m_win = 0;
             m_vramAddr = DCPU11_VRAM_START;
+            memset(m_dirtyTiles, 0xff, sizeof(m_dirtyTiles));
+            m_screenDirty = true;
             //m_ramVizCursor = 0;
         }
 
@@ -64,11 +70,17 @@ namespace dcpu11
         // Runs the emulator
         void run();
 
+        // Called when the DCPU writes to VRAM
+        virtual void onMemoryWrite(u16 addr, u16 value);
+
     private :
 
         // Updates the screen from video RAM
         void drawScreen();
 
+        // Redraws one tile in the screen image
+        void drawTile(u16 x, u16 y, u16 word);
+
         void drawCPUState();
 
         // Updates the DCPU16
@@ -3,33 +3,128 @@
 #include "Assembler.hpp"
 #include "utility.hpp"
 
-// TODO Assembler: set an exception if we define a label from a reserved name
-#define addLabel(__name, __addr) \
-    m_labels.insert(std::pair<std::string,u16>(__name, __addr)).second
-
 #define CHECK_END_OF_LINE \
-    if(m_pos >= m_line.size()) { \
+    if(m_tokens[m_token].isEndOfLine()) { \
         setException("Unexpected end of line"); \
         return false; }
 
 namespace dcpu
 {
 // -----------------------------------------------------------------------------
-//	Character sets
+//	Keywords
+//
+//	Mnemonics and variable names are 4 characters long at most, so they are
+//	packed into one integer (uppercased while packing) and matched by a
+//	switch. Nothing has to be built when an Assembler is constructed.
 // -----------------------------------------------------------------------------
 
-// Defines whitespace characters
-inline bool isWhiteSpace(char c)
+#define KEYWORD2(__a, __b) (((__a) << 8) | (__b))
+#define KEYWORD3(__a, __b, __c) ((KEYWORD2(__a, __b) << 8) | (__c))
+#define KEYWORD4(__a, __b, __c, __d) ((KEYWORD3(__a, __b, __c) << 8) | (__d))
+
+// Packs a name into an integer, in uppercase.
+// Returns 0 if the name is too long to be a keyword.
+inline u32 packKeyword(const char * name, u32 size)
+{
+	if(size > 4)
+		return 0;
+
+	u32 key = 0;
+	for(u32 i = 0; i < size; ++i)
+	{
+		char c = name[i];
+		if(c >= 'a' && c <= 'z')
+			c -= 'a' - 'A';
+		key = (key << 8) | static_cast<u8>(c);
+	}
+	return key;
+}
+
+// Gets the code of a basic operation.
+// Returns false if the key is not a basic operation.
+inline bool findBasicOpcode(u32 key, u16 & opcode)
+{
+	switch(key)
+	{
+	case KEYWORD3('S', 'E', 'T'): opcode = OP_SET; break;
+	case KEYWORD3('A', 'D', 'D'): opcode = OP_ADD; break;
+	case KEYWORD3('S', 'U', 'B'): opcode = OP_SUB; break;
+	case KEYWORD3('M', 'U', 'L'): opcode = OP_MUL; break;
+	case KEYWORD3('M', 'L', 'I'): opcode = OP_MLI; break;
+	case KEYWORD3('D', 'I', 'V'): opcode = OP_DIV; break;
+	case KEYWORD3('D', 'V', 'I'): opcode = OP_DVI; break;
+	case KEYWORD3('M', 'O', 'D'): opcode = OP_MOD; break;
+	case KEYWORD3('M', 'D', 'I'): opcode = OP_MDI; break;
+	case KEYWORD3('S', 'H', 'L'): opcode = OP_SHL; break;
+	case KEYWORD3('A', 'S', 'R'): opcode = OP_ASR; break;
+	case KEYWORD3('S', 'H', 'R'): opcode = OP_SHR; break;
+	case KEYWORD3('A', 'N', 'D'): opcode = OP_AND; break;
+	case KEYWORD3('B', 'O', 'R'): opcode = OP_BOR; break;
+	case KEYWORD3('X', 'O', 'R'): opcode = OP_XOR; break;
+	case KEYWORD3('I', 'F', 'C'): opcode = OP_IFC; break;
+	case KEYWORD3('I', 'F', 'A'): opcode = OP_IFA; break;
+	case KEYWORD3('I', 'F', 'E'): opcode = OP_IFE; break;
+	case KEYWORD3('I', 'F', 'N'): opcode = OP_IFN; break;
+	case KEYWORD3('I', 'F', 'G'): opcode = OP_IFG; break;
+	case KEYWORD3('I', 'F', 'B'): opcode = OP_IFB; break;
+	case KEYWORD3('I', 'F', 'L'): opcode = OP_IFL; break;
+	case KEYWORD3('I', 'F', 'U'): opcode = OP_IFU; break;
+	case KEYWORD3('A', 'D', 'X'): opcode = OP_ADX; break;
+	case KEYWORD3('S', 'B', 'X'): opcode = OP_SBX; break;
+	case KEYWORD3('S', 'T', 'I'): opcode = OP_STI; break;
+	case KEYWORD3('S', 'T', 'D'): opcode = OP_STD; break;
+	default: return false;
+	}
+	return true;
+}
+
+// Gets the code of a non-basic operation.
+// Returns false if the key is not a non-basic operation.
+inline bool findExtendedOpcode(u32 key, u16 & opcode)
 {
-	return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	switch(key)
+	{
+	case KEYWORD3('J', 'S', 'R'): opcode = EOP_JSR; break;
+	case KEYWORD3('I', 'N', 'T'): opcode = EOP_INT; break;
+	case KEYWORD3('I', 'A', 'G'): opcode = EOP_IAG; break;
+	case KEYWORD3('I', 'A', 'S'): opcode = EOP_IAS; break;
+	case KEYWORD3('R', 'F', 'I'): opcode = EOP_RFI; break;
+	case KEYWORD3('I', 'A', 'Q'): opcode = EOP_IAQ; break;
+	case KEYWORD3('H', 'W', 'N'): opcode = EOP_HWN; break;
+	case KEYWORD3('H', 'W', 'Q'): opcode = EOP_HWQ; break;
+	case KEYWORD3('H', 'W', 'I'): opcode = EOP_HWI; break;
+	default: return false;
+	}
+	return true;
 }
 
-// Defines litteral characters
-inline bool isLitteral(char c)
+// Gets a register or another variable (PUSH, POP, PEEK, PICK, SP, PC, EX).
+// Returns false if the key is not a variable.
+inline bool findVariable(u32 key, Variable & var)
 {
-	return (c >= 'a' && c <= 'z')
-		|| (c >= 'A' && c <= 'Z')
-		|| c == '_';
+	switch(key)
+	{
+	// Registers
+	case 'A': var = Variable(AD_A, true); break;
+	case 'B': var = Variable(AD_B, true); break;
+	case 'C': var = Variable(AD_C, true); break;
+	case 'X': var = Variable(AD_X, true); break;
+	case 'Y': var = Variable(AD_Y, true); break;
+	case 'Z': var = Variable(AD_Z, true); break;
+	case 'I': var = Variable(AD_I, true); break;
+	case 'J': var = Variable(AD_J, true); break;
+
+	// Other variables
+	case KEYWORD4('P', 'U', 'S', 'H'): var = Variable(AD_PUSH_POP); break;
+	case KEYWORD3('P', 'O', 'P'): var = Variable(AD_PUSH_POP); break;
+	case KEYWORD4('P', 'E', 'E', 'K'): var = Variable(AD_PEEK); break;
+	case KEYWORD4('P', 'I', 'C', 'K'): var = Variable(AD_PICK); break;
+	case KEYWORD2('S', 'P'): var = Variable(AD_SP); break;
+	case KEYWORD2('P', 'C'): var = Variable(AD_PC); break;
+	case KEYWORD2('E', 'X'): var = Variable(AD_EX); break;
+	default: return false;
+	}
+	return true;
 }
 
 // -----------------------------------------------------------------------------
@@ -44,66 +139,9 @@ inline bool isLitteral(char c)
 
 Assembler::Assembler()
 {
+	m_relocatable = false;
+	r_fileNames = 0;
 	init();
-
-	// Basic opcodes
-	m_basicOpcodes["SET"] = OP_SET;
-	m_basicOpcodes["ADD"] = OP_ADD;
-	m_basicOpcodes["SUB"] = OP_SUB;
-	m_basicOpcodes["MUL"] = OP_MUL;
-	m_basicOpcodes["MLI"] = OP_MLI;
-	m_basicOpcodes["DIV"] = OP_DIV;
-	m_basicOpcodes["DVI"] = OP_DVI;
-	m_basicOpcodes["MOD"] = OP_MOD;
-	m_basicOpcodes["MDI"] = OP_MDI;
-	m_basicOpcodes["SHL"] = OP_SHL;
-	m_basicOpcodes["ASR"] = OP_ASR;
-	m_basicOpcodes["SHR"] = OP_SHR;
-	m_basicOpcodes["AND"] = OP_AND;
-	m_basicOpcodes["BOR"] = OP_BOR;
-	m_basicOpcodes["XOR"] = OP_XOR;
-	m_basicOpcodes["IFC"] = OP_IFC;
-	m_basicOpcodes["IFA"] = OP_IFA;
-	m_basicOpcodes["IFE"] = OP_IFE;
-	m_basicOpcodes["IFN"] = OP_IFN;
-	m_basicOpcodes["IFG"] = OP_IFG;
-	m_basicOpcodes["IFB"] = OP_IFB;
-	m_basicOpcodes["IFL"] = OP_IFL;
-	m_basicOpcodes["IFU"] = OP_IFU;
-	m_basicOpcodes["ADX"] = OP_ADX;
-	m_basicOpcodes["SBX"] = OP_SBX;
-	m_basicOpcodes["STI"] = OP_STI;
-	m_basicOpcodes["STD"] = OP_STD;
-
-	// Non-basic opcodes
-	m_extendedOpcodes["JSR"] = EOP_JSR;
-	m_extendedOpcodes["INT"] = EOP_INT;
-	m_extendedOpcodes["IAG"] = EOP_IAG;
-	m_extendedOpcodes["IAS"] = EOP_IAS;
-	m_extendedOpcodes["RFI"] = EOP_RFI;
-	m_extendedOpcodes["IAQ"] = EOP_IAQ;
-	m_extendedOpcodes["HWN"] = EOP_HWN;
-	m_extendedOpcodes["HWQ"] = EOP_HWQ;
-	m_extendedOpcodes["HWI"] = EOP_HWI;
-
-	// Registers
-	m_variables["A"] = Variable(AD_A, true);
-	m_variables["B"] = Variable(AD_B, true);
-	m_variables["C"] = Variable(AD_C, true);
-	m_variables["X"] = Variable(AD_X, true);
-	m_variables["Y"] = Variable(AD_Y, true);
-	m_variables["Z"] = Variable(AD_Z, true);
-	m_variables["I"] = Variable(AD_I, true);
-	m_variables["J"] = Variable(AD_J, true);
-
-	// Other variables
-	m_variables["PUSH"] = Variable(AD_PUSH_POP);
-	m_variables["POP"] =  Variable(AD_PUSH_POP);
-	m_variables["PEEK"] = Variable(AD_PEEK);
-	m_variables["PICK"] = Variable(AD_PICK);
-	m_variables["SP"] =   Variable(AD_SP);
-	m_variables["PC"] =   Variable(AD_PC);
-	m_variables["EX"] =   Variable(AD_EX);
 }
 
 // Resets the assembler and leaves it ready to process a new stream
@@ -111,95 +149,114 @@ void Assembler::init()
 {
 	memset(m_ram, 0, DCPU_RAM_SIZE * sizeof(u16));
 
-	m_pos = 0;
+	m_tokens = 0;
+	m_token = 0;
 	m_row = 0;
+	m_file = 0;
 	m_addr = 0;
 
+	m_symbols.clear();
 	m_labels.clear();
+	m_labelDefs.clear();
 	m_labelUses.clear();
 
 	m_exceptionString.clear();
 }
 
-bool Assembler::skipWhiteSpace()
+void Assembler::setException(const std::string & msg)
 {
-	while(m_pos < m_line.size())
+	setException(msg, m_row, m_tokens != 0 ? m_tokens[m_token].col : 0, m_file);
+}
+
+void Assembler::setException(const std::string & msg, u32 row, u32 col, u32 file)
+{
+	m_exceptionString = getLocatedMessage(msg, row, col, file, r_fileNames, m_tokens);
+}
+
+bool Assembler::assembleStream(std::istream & is)
+{
+	if(!readStream(is, m_source))
 	{
-		if(isWhiteSpace(m_line[m_pos]))
-			++m_pos;
-		else
-			break;
+		setException("Couldn't read the source stream");
+		return false;
 	}
 
-	return m_pos < m_line.size();
+	const bool res = assembleBuffer(
+		m_source.empty() ? 0 : &m_source[0], m_source.size());
+
+	// Release the source (error messages hold a copy of the faulty line)
+	std::vector<char>().swap(m_source);
+	return res;
 }
 
-void Assembler::setException(const std::string & msg)
+bool Assembler::assembleBuffer(const char * data, u32 size)
 {
-	std::stringstream ss;
-	ss << msg << ", at line " << m_row+1 << ", col " << m_pos+1;
-	if(!m_line.empty())
-		ss << ", near '" << m_line << "'";
-	m_exceptionString = ss.str();
+	Lexer lexer(data, size);
+	std::vector<Token> tokens;
+	Token token;
+
+	// Comments are not needed
+	do
+	{
+		lexer.next(token);
+		if(token.type != TOKEN_COMMENT)
+			tokens.push_back(token);
+	} while(token.type != TOKEN_END);
+
+	return assembleTokens(tokens);
 }
 
-bool Assembler::assembleStream(std::istream & is)
+bool Assembler::assembleTokens(const std::vector<Token> & tokens)
 {
-	while(!is.eof())
-	{
-		// Get line
-		std::string line;
-		char c = 0;
-		// TODO Assembler: make the newline char work on other OS than Linux
-		// TODO Assembler: use getline. Seriously.
-		while(c != '\n')
-		{
-			if(is.eof())
-				break;
-			c = is.get(); // Note : 'is >>' is a formatting operator, should not be used here
-			if(is.eof())
-				break;
-			if(c != '\n')
-				line += c;
-		}
+	return tokens.empty() || assembleTokens(&tokens[0], tokens.size());
+}
 
-#ifdef DCPU_DEBUG
-		std::cout << "\nAssembling line " << m_row << "..." << std::endl;
-		std::cout << "'" << line << "'" << std::endl;
-#endif
+bool Assembler::assembleTokens(const Token * tokens, u32 count)
+{
+	if(count != 0 && !tokens[count - 1].isEndOfLine())
+	{
+		setException("The last line of tokens has no end");
+		return false;
+	}
 
+	for(u32 i = 0; i < count; ++i)
+	{
 		// Assemble line
-		if(!assembleLine(line))
+		if(!assembleLine(&tokens[i]))
 		{
 			if(!isException())
 				setException("Unknown error"); // should not occur
+			m_tokens = 0;
 			return false;
 		}
-		++m_row;
+
+		// Go to the end of the line
+		while(!tokens[i].isEndOfLine())
+			++i;
 	}
 
+	// Label errors don't refer to the last line
+	m_tokens = 0;
+
 	return assembleLabels();
 }
 
-bool Assembler::assembleLine(const std::string & str)
+bool Assembler::assembleLine(const Token * tokens)
 {
-	m_line = str;
-	m_pos = 0;
+	m_tokens = tokens;
+	m_token = 0;
+	m_row = tokens[0].row;
+	m_file = tokens[0].file;
 
-	if(!skipWhiteSpace())
-		return true; // the line is empty
-
-	// Comment
-
-	if(m_line[m_pos] == ';')
-	{
 #ifdef DCPU_DEBUG
-		std::cout << "Skipping comment..." << std::endl;
+	std::cout << "\nAssembling line " << m_row << "..." << std::endl;
+	std::cout << "'" << tokensToString(tokens, -1) << "'" << std::endl;
 #endif
-		return true;
-	}
 
-	// TODO Assembler: check the last interpreted character of a line to be ';' or a newline
+	if(tokens[0].isEndOfLine())
+		return true; // the line is empty, or a comment
+
+	// TODO Assembler: check the last interpreted token of a line to be the end of line
 
 	//
 	// Label definition
@@ -207,93 +264,85 @@ bool Assembler::assembleLine(const std::string & str)
 
 	// TODO Assembler: allow ":label <op stuff...>" syntax
 
-	if(m_line[m_pos] == ':')
+	if(m_tokens[m_token].isPunctuation(':'))
 	{
 #ifdef DCPU_DEBUG
 		std::cout << "Label definition..." << std::endl;
 #endif
-		++m_pos;
+		++m_token;
 		CHECK_END_OF_LINE
-		std::string labelName;
-		if(parseName(labelName, "label name"))
+		if(!checkName("label name"))
+			return false;
+
+		const Token & name = m_tokens[m_token];
+		const u32 symbol = m_symbols.intern(name.text, name.size);
+		if(!addLabel(LabelUse(symbol, m_addr, m_row, name.col, m_file)))
 		{
-			if(addLabel(labelName, m_addr))
-				return true;
-			else
-			{
-				setException("Label '" + labelName + "' defined twice");
-				return false;
-			}
-		}
-		else
+			setException(getDefinedTwiceMessage(m_symbols.getName(symbol)));
 			return false;
+		}
+		return true;
 	}
 
 	//
 	// Operations
 	//
 
-	std::string opname;
-	if(!parseName(opname, "opname"))
+	if(!checkName("opname"))
 		return false;
 
-	strToUpper(opname);
+	const Token & opname = m_tokens[m_token];
+	const u32 key = packKeyword(opname.text, opname.size);
+	u16 opcode = 0;
+	++m_token;
 
 #ifdef DCPU_DEBUG
-	std::cout << "Opname : " << opname << " : ";
+	std::cout << "Opname : " << opname.toString() << " : ";
 #endif
 
 	// Basic operation
 
-	std::map<std::string,u16>::iterator it = m_basicOpcodes.find(opname);
-	if(it != m_basicOpcodes.end())
+	if(findBasicOpcode(key, opcode))
 	{
 #ifdef DCPU_DEBUG
 		std::cout << "Basic operation" << std::endl;
 #endif
-		u16 opcode = it->second;
 		Operand b, a;
 
 		if(!parseNextOperand(b))
 			return false;
 
-		skipWhiteSpace();
 		CHECK_END_OF_LINE
-		if(m_line[m_pos] != ',')
+		if(!m_tokens[m_token].isPunctuation(','))
 		{
 			setException("Expected ',' after operand");
 			return false;
 		}
 
-		++m_pos; // skip the comma
+		++m_token; // skip the comma
 		CHECK_END_OF_LINE
 
 		if(!parseNextOperand(a))
 			return false;
 
-		assembleBasicOp(opcode, b, a);
-		return true;
+		return assembleBasicOp(opcode, b, a);
 	}
 
 	// Extended operation
 
-	it = m_extendedOpcodes.find(opname);
-	if(it != m_extendedOpcodes.end())
+	if(findExtendedOpcode(key, opcode))
 	{
 #ifdef DCPU_DEBUG
 		std::cout << "Non-basic operation" << std::endl;
 #endif
-		u16 opcode = it->second;
-
 		Operand a;
-		if(opname != "RFI") // RFI's arg has no effect
+		if(opcode != EOP_RFI) // RFI's arg has no effect
 		{
 			if(!parseNextOperand(a))
 				return false;
 		}
 
-		assembleExtendedOp(opcode, a);
-		return true;
+		return assembleExtendedOp(opcode, a);
 	}
 
 	// Assembly operation
@@ -301,7 +350,7 @@ bool Assembler::assembleLine(const std::string & str)
 #ifdef DCPU_DEBUG
 	std::cout << "Assembly operation" << std::endl;
 #endif
-	if(opname == "DAT")
+	if(key == KEYWORD3('D', 'A', 'T'))
 	{
 		if(!assembleData())
 			return false;
@@ -310,17 +359,18 @@ bool Assembler::assembleLine(const std::string & str)
 
 	// Unrecognized
 
-	setException("Unrecognized command '" + opname + "'");
+	std::string name = opname.toString();
+	strToUpper(name);
+	setException("Unrecognized command '" + name + "'");
 	return false;
 }
 
 bool Assembler::parseNextOperandNoLookup(Operand & op)
 {
-	skipWhiteSpace();
 	CHECK_END_OF_LINE
 
-	const char c = m_line[m_pos];
-	if(isdigit(c))
+	const Token & t = m_tokens[m_token];
+	if(t.type == TOKEN_NUMBER)
 	{
 		// Value
 		#ifdef DCPU_DEBUG
@@ -332,30 +382,19 @@ bool Assembler::parseNextOperandNoLookup(Operand & op)
 		if(!parseU16(op.value))
 			return false;
 	}
-	else if(isLitteral(c))
+	else if(t.type == TOKEN_NAME)
 	{
 		// Variable or label ?
 
-		std::string name;
-		if(!parseName(name))
-			return false;
-
-		std::map<std::string,Variable>::iterator it = m_variables.find(name);
-		if(it == m_variables.end())
-		{
-			// If the variable was not found, retry with its uppercase version
-			std::string uprName = name;
-			strToUpper(uprName);
-			it = m_variables.find(uprName);
-		}
-		if(it != m_variables.end())
+		Variable var;
+		if(findVariable(packKeyword(t.text, t.size), var))
 		{
 			// Variable
 #ifdef DCPU_DEBUG
 			std::cout << "Found variable" << std::endl;
 #endif
-			op.value = it->second.addr;
-			op.isRegister = it->second.isRegister;
+			op.value = var.addr;
+			op.isRegister = var.isRegister;
 		}
 		else
 		{
@@ -364,13 +403,20 @@ bool Assembler::parseNextOperandNoLookup(Operand & op)
 			std::cout << "Found label" << std::endl;
 #endif
 			LabelUse u;
-			u.name = name;
+			u.symbol = m_symbols.intern(t.text, t.size);
 			u.row = m_row;
-			u.col = m_pos;
+			u.col = t.col;
+			u.file = m_file;
 			// Note: we know the label use adress on assembling
 			op.labelUse = u;
 			op.isLabel = true;
 		}
+		++m_token;
+	}
+	else if(t.type == TOKEN_INVALID)
+	{
+		setException(Lexer::getInvalidMessage(t));
+		return false;
 	}
 	else
 	{
@@ -386,11 +432,9 @@ bool Assembler::parseNextOperand(Operand & op)
 	std::cout << "Parsing next operand..." << std::endl;
 #endif
 
-	skipWhiteSpace();
 	CHECK_END_OF_LINE
 
-	char c = m_line[m_pos];
-	if(c == '[')
+	if(m_tokens[m_token].isPunctuation('['))
 	{
 		// Lookup
 
@@ -399,23 +443,21 @@ bool Assembler::parseNextOperand(Operand & op)
 #endif
 
 		op.lookup = true;
-		++m_pos;
-		skipWhiteSpace();
+		++m_token;
 		CHECK_END_OF_LINE
 
 		if(!parseNextOperandNoLookup(op))
 			return false;
 
-		skipWhiteSpace();
 		CHECK_END_OF_LINE
 
-		if(m_line[m_pos] == '+')
+		if(m_tokens[m_token].isPunctuation('+'))
 		{
 #ifdef DCPU_DEBUG
 			std::cout << "Found '+'" << std::endl;
 #endif
 			// Syntax of [nextword + register]
-			m_pos++;
+			++m_token;
 			Operand op2;
 			if(!parseNextOperandNoLookup(op2))
 				return false;
@@ -476,13 +518,12 @@ bool Assembler::parseNextOperand(Operand & op)
 			}
 		}
 
-		skipWhiteSpace();
 		CHECK_END_OF_LINE
 
-		c = m_line[m_pos];
+		const char c = m_tokens[m_token].text[0];
 		if(c == ']')
 		{
-			++m_pos;
+			++m_token;
 			return true;
 		}
 		else
@@ -503,179 +544,84 @@ bool Assembler::parseNextOperand(Operand & op)
 	return true;
 }
 
-// Parses a set of characters included in a-zA-Z_0-9.
+// Sets an exception if the current token is not a name.
 // Param what is the type of name (for debug).
-bool Assembler::parseName(std::string & name, std::string what)
+bool Assembler::checkName(std::string what)
 {
-	// The current pos must be vallid
-	if(m_pos >= m_line.size())
-	{
-		setException("Expected name, got nothing");
-		return false;
-	}
+	const Token & t = m_tokens[m_token];
+	if(t.type == TOKEN_NAME)
+		return true;
 
-	// The first letter must be a litteral
-	char c = m_line[m_pos];
-	if(!isLitteral(c))
-	{
-		if(what.empty())
-			what = "name";
-		std::stringstream ss;
-		ss << "The first letter of a" << (isVowel(what[0]) ? "n " : " ")
-			<< what << " must be a litteral, got '"
-			<< c << "' (" << (int)c << ")";
-		setException(ss.str());
-		return false;
-	}
+	if(what.empty())
+		what = "name";
 
-	while(m_pos < m_line.size())
+	if(t.isEndOfLine())
 	{
-		c = m_line[m_pos];
-		if(!isLitteral(c) && !isdigit(c))
-			break;
-		if(c == ';')
-			break;
-		name += c;
-		++m_pos;
+		setException("Expected " + what + ", got nothing");
+		return false;
 	}
 
-	return true;
+	// The first letter must be a litteral
+	const char c = t.text[0];
+	std::stringstream ss;
+	ss << "The first letter of a" << (isVowel(what[0]) ? "n " : " ")
+		<< what << " must be a litteral, got '"
+		<< c << "' (" << (int)c << ")";
+	setException(ss.str());
+	return false;
 }
 
 bool Assembler::parseU16(u16 & value)
 {
-	if(m_pos >= m_line.size())
-	{
-		setException("Expected numeric, got nothing");
-		return false;
-	}
-
-	if(!isdigit(m_line[m_pos]))
-	{
-		setException("Expected numeric");
-		return false;
-	}
-
-	if(m_pos + 1 >= m_line.size())
-	{
-		// One decimal digit
-		value = m_line[m_pos] - '0';
-		return true;
-	}
-
-	if(m_line[m_pos] == '0')
-	{
-		++m_pos;
-		CHECK_END_OF_LINE
-		char c = m_line[m_pos];
-		if(c == 'x')
-		{
-			// Hex value
-			++m_pos; // skip the 'x'
-			CHECK_END_OF_LINE
-			return parseHexU16(value);
-		}
-		else if(isLitteral(c))
-		{
-			setException("Unrecognized litteral used in numeric");
-			return false;
-		}
-		else
-		{
-			// assume this is just a 0
-			value = 0;
-			return true;
-		}
-	}
-
-	return parseDecU16(value);
-}
+	const Token & t = m_tokens[m_token];
 
-bool Assembler::parseHexU16(u16 & value)
-{
-	if(m_pos >= m_line.size())
+	if(t.isEndOfLine())
 	{
 		setException("Expected numeric, got nothing");
 		return false;
 	}
 
-	if(!isHexDigit(m_line[m_pos]))
+	if(t.type == TOKEN_INVALID)
 	{
-		std::stringstream ss;
-		ss << "Expected hex digit, got '" << m_line[m_pos] << "'";
-		setException(ss.str());
+		setException(Lexer::getInvalidMessage(t));
 		return false;
 	}
 
-	value = 0;
-	char c;
-	for(u8 d = 0; d < 4 && m_pos < m_line.size(); d++, m_pos++)
+	if(t.type != TOKEN_NUMBER)
 	{
-		c = m_line[m_pos];
-		if(!isHexDigit(c))
-			break;
-		value <<= 4;
-		value += hexDigitToInt(c);
-	}
-
-	return true;
-}
-
-bool Assembler::parseDecU16(u16 & value)
-{
-	if(m_pos >= m_line.size())
-	{
-		setException("Expected numeric, got nothing");
-		return false;
-	}
-
-	if(!isdigit(m_line[m_pos]))
-	{
-		std::stringstream ss;
-		ss << "Expected digit, got '" << m_line[m_pos] << "'";
-		setException(ss.str());
+		setException("Expected numeric");
 		return false;
 	}
 
-	u32 readValue = 0;
-	char c;
-	for(u8 d = 0; d < 5 && m_pos < m_line.size(); ++d, ++m_pos)
-	{
-		c = m_line[m_pos];
-		if(!isdigit(c))
-			break;
-		readValue *= 10;
-		readValue += c - '0';
-	}
-
-	if(readValue > 0xffff)
+	if(t.value > 0xffff)
 	{
 		setException("16-bit invalid value, max is 0xffff (65535)");
 		return false;
 	}
 
-	value = readValue;
+	value = t.value;
+	++m_token;
 	return true;
 }
 
 bool Assembler::assembleString()
 {
-	if(!m_line[m_pos] == '"')
+	const Token & t = m_tokens[m_token];
+	if(t.type != TOKEN_STRING)
 		return false;
 
-	++m_pos;
-	CHECK_END_OF_LINE;
 	// TODO Assembler: handle escape chars
-	for(; m_line[m_pos] != '"'; ++m_pos, ++m_addr)
+	const char * str = t.getStringBegin();
+	for(u32 i = 0; i < t.getStringSize(); ++i, ++m_addr)
 	{
 		if(m_addr >= DCPU_RAM_SIZE)
 		{
 			setException("Out of memory");
 			return false;
 		}
-		m_ram[m_addr] = m_line[m_pos];
+		m_ram[m_addr] = str[i];
 	}
-	++m_pos;
+	++m_token;
 	return true;
 }
 
@@ -686,11 +632,10 @@ bool Assembler::assembleData()
 	{
 		--counter;
 
-		skipWhiteSpace();
 		CHECK_END_OF_LINE
 
-		char c = m_line[m_pos];
-		if(c == '"')
+		const Token & t = m_tokens[m_token];
+		if(t.type == TOKEN_STRING)
 		{
 #ifdef DCPU_DEBUG
 			std::cout << "Found string" << std::endl;
@@ -699,7 +644,7 @@ bool Assembler::assembleData()
 			if(!assembleString())
 				return false;
 		}
-		else if(isdigit(c))
+		else if(t.type == TOKEN_NUMBER)
 		{
 #ifdef DCPU_DEBUG
 			std::cout << "Found word" << std::endl;
@@ -716,18 +661,19 @@ bool Assembler::assembleData()
 			m_ram[m_addr] = word;
 			++m_addr;
 		}
+		else if(t.type == TOKEN_INVALID)
+		{
+			setException(Lexer::getInvalidMessage(t));
+			return false;
+		}
 		else
 		{
 			setException("Unknown data");
 			return false;
 		}
 
-		skipWhiteSpace();
-		if(m_pos >= m_line.size())
-			break;
-
-		if(m_line[m_pos] == ',')
-			++m_pos;
+		if(m_tokens[m_token].isPunctuation(','))
+			++m_token;
 		else
 			break;
 	}
@@ -797,23 +743,26 @@ bool Assembler::getOperandCode(const Operand & op, u16 & code, bool isB)
 	}
 }
 
+// TODO Assembler: set an exception if we define a label from a reserved name
+bool Assembler::addLabel(const LabelUse & def)
+{
+	if(def.symbol >= m_labels.size())
+	{
+		m_labels.resize(m_symbols.getCount(), DCPU_LABEL_UNDEFINED);
+		m_labelDefs.resize(m_symbols.getCount());
+	}
+	if(m_labels[def.symbol] != DCPU_LABEL_UNDEFINED)
+		return false;
+	m_labels[def.symbol] = def.addr;
+	m_labelDefs[def.symbol] = def;
+	return true;
+}
+
 // Keep track of a label use in order to write their adresses
 // later in the assembly (assembling is done in two passes)
 void Assembler::addLabelUse(const LabelUse & lu)
 {
-	std::map<
-		std::string,
-		std::list<LabelUse> >::iterator it = m_labelUses.find(lu.name);
-
-	if(it != m_labelUses.end())
-		it->second.push_back(lu);
-	else
-	{
-		std::pair<std::string, std::list<LabelUse> > p;
-		p.first = lu.name;
-		p.second.push_back(lu);
-		m_labelUses.insert(p);
-	}
+	m_labelUses.push_back(lu);
 }
 
 bool Assembler::assembleFullWordOperand(const Operand & op)
@@ -842,6 +791,12 @@ bool Assembler::assembleBasicOp(u16 opcode, Operand b, Operand a)
 
 	std::cout << "opcode=" << opcode << ", b=" << b.code << ", a=" << a.code << std::endl;
 
+	if(m_addr > 0xffff)
+	{
+		setException("Out of memory");
+		return false;
+	}
+
 	u16 op = opcode; // operation word
 	op = encodeA(op, a.code);
 	op = encodeB(op, b.code);
@@ -860,6 +815,12 @@ bool Assembler::assembleExtendedOp(u16 opcode, Operand a)
 {
 	if(!getOperandCode(a, a.code, false)) return false;
 
+	if(m_addr > 0xffff)
+	{
+		setException("Out of memory");
+		return false;
+	}
+
 	u16 op = 0; // operation word
 	op = encodeExOp(op, opcode);
 	op = encodeExA(op, a.code);
@@ -872,6 +833,43 @@ bool Assembler::assembleExtendedOp(u16 opcode, Operand a)
 	return true;
 }
 
+std::string Assembler::getUndefinedLabelMessage(const std::string & name)
+{
+	std::stringstream ss;
+	ss << "Undefined label '" << name << "'";
+	if(name == "o" || name == "O")
+	{
+		ss << " (this is the old name for overflow, maybe you should use EX instead?)";
+	}
+	return ss.str();
+}
+
+std::string Assembler::getLocatedMessage(const std::string & msg,
+	u32 row, u32 col, u32 file, const std::vector<std::string> * fileNames)
+{
+	std::stringstream ss;
+	if(file != 0 && fileNames != 0 && file < fileNames->size())
+		ss << (*fileNames)[file] << ": ";
+	ss << msg << ", at line " << row+1 << ", col " << col+1;
+	return ss.str();
+}
+
+std::string Assembler::getLocatedMessage(const std::string & msg,
+	u32 row, u32 col, u32 file, const std::vector<std::string> * fileNames,
+	const Token * line)
+{
+	std::stringstream ss;
+	ss << getLocatedMessage(msg, row, col, file, fileNames);
+	if(line != 0 && !line[0].isEndOfLine())
+		ss << ", near '" << tokensToString(line, -1) << "'";
+	return ss.str();
+}
+
+std::string Assembler::getDefinedTwiceMessage(const std::string & name)
+{
+	return "Label '" + name + "' defined twice";
+}
+
 // Called after first assembling pass :
 // write label adresses where they are needed
 bool Assembler::assembleLabels()
@@ -888,35 +886,20 @@ bool Assembler::assembleLabels()
 #endif // DCPU_DEBUG
 	}
 
-	std::map<std::string, std::list<LabelUse> >::iterator usesIt;
-	std::map<std::string, u16>::iterator labelIt;
-	std::list<LabelUse>::const_iterator useListIt;
+	// Labels used but never defined have no address
+	m_labels.resize(m_symbols.getCount(), DCPU_LABEL_UNDEFINED);
 
-	for(usesIt = m_labelUses.begin(); usesIt != m_labelUses.end(); usesIt++)
+	for(u32 i = 0; i < m_labelUses.size(); ++i)
 	{
-		const std::list<LabelUse> & useList = usesIt->second;
-		for(useListIt = useList.begin(); useListIt != useList.end(); useListIt++)
+		const LabelUse & use = m_labelUses[i];
+		const u32 addr = m_labels[use.symbol];
+		if(addr != DCPU_LABEL_UNDEFINED)
+			m_ram[use.addr] = addr;
+		else if(!m_relocatable)
 		{
-			const LabelUse & use = *useListIt;
-
-			labelIt = m_labels.find(use.name);
-			if(labelIt != m_labels.end())
-			{
-				m_ram[use.addr] = labelIt->second;
-			}
-			else
-			{
-				m_pos = use.col;
-				m_row = use.row;
-				std::stringstream ss;
-				ss << "Undefined label '" << use.name << "'";
-				if(use.name == "o" || use.name == "O")
-				{
-					ss << " (this is the old name for overflow, maybe you should use EX instead?)";
-				}
-				setException(ss.str());
-				return false;
-			}
+			setException(getUndefinedLabelMessage(m_symbols.getName(use.symbol)),
+				use.row, use.col, use.file);
+			return false;
 		}
 	}
 
@@ -2,27 +2,36 @@
 #define HEADER_DCPUASSEMBLER_HPP_INCLUDED
 
 #include <iostream>
-#include <map>
 #include <string>
-#include <list>
+#include <vector>
 
 #include "DCPU.hpp"
+#include "Lexer.hpp"
+#include "SymbolTable.hpp"
+
+// Address of a label that is not defined yet
+#define DCPU_LABEL_UNDEFINED 0xffffffff
+
+// Must be incremented when the same source can give a different image
+// (cached images of older versions are then ignored)
+#define DCPU_ASSEMBLER_VERSION 1
 
 namespace dcpu
 {
 // Internal use
 struct LabelUse
 {
-	std::string name;
+	u32 symbol; // ID in the symbol table
+	u32 row;
 	u16 addr;
-	u16 row;
 	u16 col;
+	u16 file; // See Token::file
 
-	LabelUse() : addr(0), row(0), col(0)
+	LabelUse() : symbol(DCPU_SYMBOL_NONE), row(0), addr(0), col(0), file(0)
 	{}
 
-	LabelUse(const std::string & name, u16 addr0, u16 row0, u16 col0)
-	: name(name), addr(addr0), row(row0), col(col0)
+	LabelUse(u32 symbol0, u16 addr0, u32 row0, u16 col0, u16 file0 = 0)
+	: symbol(symbol0), row(row0), addr(addr0), col(col0), file(file0)
 	{}
 };
 
@@ -57,7 +66,6 @@ struct Variable
 	{}
 };
 
-// TODO Assembler: should use the new generic Parser
 // Note: this assembler takes to much lines. I'm sure there is a shorter way to implement it.
 
 class Assembler
@@ -69,54 +77,109 @@ public :
 	// Resets the assembler and leaves it ready to process a new stream
 	void init();
 
+	// If relocatable is true, the program is assembled as a part of a
+	// program (see ObjectFile): labels it uses without defining them are
+	// left to 0 instead of being errors. Addresses start at 0 anyway.
+	void setRelocatable(bool relocatable) { m_relocatable = relocatable; }
+
+	// Paths of the files tokens come from, indexed by Token::file
+	// (see Preprocessor::getFileNames), so errors in included files
+	// can tell where they are. They must stay valid while assembling.
+	void setFileNames(const std::vector<std::string> * fileNames) { r_fileNames = fileNames; }
+
 	// Assembles a program from a stream (usually a file stream).
+	// The whole stream is read at once, then assembled with assembleBuffer.
 	// Returns false if an error occurred. If so, the error message
 	// should be stored in the exception string.
 	bool assembleStream(std::istream & is);
 
+	// Assembles a program from source text in memory.
+	// The text is split into tokens by a Lexer, which point into it
+	// (nothing is copied). data must stay valid until this returns.
+	bool assembleBuffer(const char * data, u32 size);
+
+	// Assembles a program from tokens (usually given by a Preprocessor).
+	// Each line ends with TOKEN_END_OF_LINE (or TOKEN_END), comments are
+	// not expected. The source the tokens point to must stay valid
+	// until this returns.
+	bool assembleTokens(const std::vector<Token> & tokens);
+	bool assembleTokens(const Token * tokens, u32 count);
+
 	const u16 * getAssembly() const { return m_ram; }
 
+	// Label names met in the program (defined or not)
+	const SymbolTable & getSymbols() const { return m_symbols; }
+
+	// Returns the address of a label given its ID in getSymbols(),
+	// or DCPU_LABEL_UNDEFINED
+	u32 getLabelAddress(u32 symbol) const
+	{ return symbol < m_labels.size() ? m_labels[symbol] : DCPU_LABEL_UNDEFINED; }
+
+	// Where a defined label is (the column is the one of its name)
+	const LabelUse & getLabelDefinition(u32 symbol) const
+	{ return m_labelDefs[symbol]; }
+
+	// Words where a label address is written, in source order
+	const std::vector<LabelUse> & getLabelUses() const { return m_labelUses; }
+
+	// Number of words assembled
+	u32 getSize() const { return m_addr; }
+
 	const std::string & getExceptionString() const
 	{ return m_exceptionString; }
 
 	bool isException() const
 	{ return !m_exceptionString.empty(); }
 
+	// Error message for a label used but never defined
+	static std::string getUndefinedLabelMessage(const std::string & name);
+
+	// Appends the location of an error to its message.
+	// Errors in an included file (file != 0) begin with its path,
+	// if fileNames is given.
+	static std::string getLocatedMessage(const std::string & msg,
+		u32 row, u32 col, u32 file, const std::vector<std::string> * fileNames);
+
+	// Same, followed by the tokens of the line, if it is not empty
+	static std::string getLocatedMessage(const std::string & msg,
+		u32 row, u32 col, u32 file, const std::vector<std::string> * fileNames,
+		const Token * line);
+
+	// Error message for a label defined more than once
+	static std::string getDefinedTwiceMessage(const std::string & name);
+
 private :
 
+	// Sets the exception message, located at the current token
 	void setException(const std::string & msg);
+	void setException(const std::string & msg, u32 row, u32 col, u32 file);
 
 	//
-	// Parsing
+	// Parsing (methods below advance m_token)
 	//
 
-	// SKips whitespace like ' ' or '\t' (see isWhiteSpace(char c)).
-	// Returns false if reached end of current line.
-	bool skipWhiteSpace();
-
 	// Parses the next operand for an operation
 	bool parseNextOperand(Operand & op);
 
 	// Parses the next operand without '[...]'
 	bool parseNextOperandNoLookup(Operand & op);
 
-	// Parses a set of characters included in a-zA-Z_0-9.
+	// Sets an exception if the current token is not a name.
 	// Param what is the type of name (for debug).
-	bool parseName(std::string & name, std::string what = "name");
+	// (does not advance m_token)
+	bool checkName(std::string what = "name");
 
-	// Parses an integer using one of the two functions below
+	// Parses a 16-bit integer (123 or 0x7b)
 	bool parseU16(u16 & value);
-
-	// Parses an integer written in decimal form (123456789)
-	bool parseDecU16(u16 & value);
-
-	// Parses an integer written in hexadecimal form (0x123456789abcdef)
-	bool parseHexU16(u16 & value);
 
 	//
 	// Assembling
 	//
 
+	// Defines a label at def.addr, located by def.
+	// Returns false if the label was already defined.
+	bool addLabel(const LabelUse & def);
+
 	// Keep track of a label use in order to write their adresses
 	// later in the assembly (assembling is done in two passes)
 	void addLabelUse(const LabelUse & lu);
@@ -128,8 +191,9 @@ private :
 	bool getOperandCode(const Operand & op, u16 & code, bool isB);
 
 	// Parses and assembles one line of code.
+	// tokens must end with TOKEN_END_OF_LINE or TOKEN_END.
 	// Returns false if read unexpected stuff, true if it's fine
-	bool assembleLine(const std::string & str);
+	bool assembleLine(const Token * tokens);
 
 	// Parses and assembles data values from code (DAT keyword)
 	bool assembleData();
@@ -154,17 +218,20 @@ private :
 private :
 
 	u16 m_ram[DCPU_RAM_SIZE];
-	std::string m_line;
-	u32 m_pos;
+	std::vector<char> m_source; // Source read by assembleStream
+	const Token * m_tokens; // Tokens of the current line
+	u32 m_token; // Index of the current token
 	u32 m_row;
+	u32 m_file; // File of the current line
 	u32 m_addr;
 	std::string m_exceptionString;
+	bool m_relocatable;
+	const std::vector<std::string> * r_fileNames;
 
-	std::map<std::string,u16>                   m_basicOpcodes; // name, code
-	std::map<std::string,u16>                   m_extendedOpcodes; // name, code
-	std::map<std::string,Variable>              m_variables; // name, var
-	std::map<std::string,u16>                   m_labels; // name, address
-	std::map<std::string,std::list<LabelUse> >  m_labelUses; // name, uses
+	SymbolTable m_symbols; // Label names
+	std::vector<u32> m_labels; // Label addresses, indexed by symbol ID
+	std::vector<LabelUse> m_labelDefs; // Where labels are defined, same index
+	std::vector<LabelUse> m_labelUses; // In source order
 
 };
 
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+#ifdef WINDOWS
+	#include <process.h>
+	#define getpid _getpid
+#else // Assumed POSIX
+	#include <unistd.h>
+#endif
+
+#include "AssemblyCache.hpp"
+#include "utility.hpp"
+
+namespace dcpu
+{
+// Cache files begin with this
+static const char s_magic[4] = {'D', 'C', 'P', 'C'};
+
+// FNV-1a, 64-bit
+static const sf::Uint64 FNV_OFFSET = 14695981039346656037ULL;
+static const sf::Uint64 FNV_PRIME = 1099511628211ULL;
+
+static void hashBytes(sf::Uint64 & h, const char * data, u32 size)
+{
+	for(u32 i = 0; i < size; ++i)
+	{
+		h ^= static_cast<u8>(data[i]);
+		h *= FNV_PRIME;
+	}
+}
+
+static void hashU32(sf::Uint64 & h, u32 value)
+{
+	const char bytes[4] = {
+		static_cast<char>(value & 0xff),
+		static_cast<char>((value >> 8) & 0xff),
+		static_cast<char>((value >> 16) & 0xff),
+		static_cast<char>((value >> 24) & 0xff)
+	};
+	hashBytes(h, bytes, 4);
+}
+
+void AssembledProgram::set(const ObjectFile & object)
+{
+	u32 size = object.section.size();
+	while(size != 0 && object.section[size - 1] == 0)
+		--size;
+	image.assign(object.section.begin(), object.section.begin() + size);
+
+	labelNames.clear();
+	labelAddresses.clear();
+	for(u32 i = 0; i < object.exports.size(); ++i)
+	{
+		labelNames.push_back(object.exports[i].name);
+		labelAddresses.push_back(object.exports[i].addr);
+	}
+}
+
+void AssembledProgram::getMemory(u16 ram[DCPU_RAM_SIZE]) const
+{
+	for(u32 i = 0; i < DCPU_RAM_SIZE; ++i)
+		ram[i] = i < image.size() ? image[i] : 0;
+}
+
+AssemblyCache::AssemblyCache(const std::string & dir) : m_dir(dir)
+{
+	if(!m_dir.empty() && m_dir[m_dir.size() - 1] != '/' && m_dir[m_dir.size() - 1] != DIR_CHAR)
+		m_dir += DIR_CHAR;
+}
+
+sf::Uint64 AssemblyCache::computeKey(
+	const std::vector<Token> & tokens,
+	const std::map<std::string, IncludedFile> & files)
+{
+	sf::Uint64 h = FNV_OFFSET;
+
+	hashU32(h, DCPU_ASSEMBLER_VERSION);
+	hashU32(h, DCPU_ASSEMBLY_CACHE_VERSION);
+
+	// Line endings and spacing don't change the image,
+	// so only token types and texts are hashed
+	for(u32 i = 0; i < tokens.size(); ++i)
+	{
+		const Token & t = tokens[i];
+		const char type = t.type;
+		hashBytes(h, &type, 1);
+		if(!t.isEndOfLine())
+		{
+			hashU32(h, t.size);
+			hashBytes(h, t.text, t.size);
+		}
+	}
+
+	// Their content is in the tokens, but errors and
+	// labels depend on which files were used
+	std::map<std::string, IncludedFile>::const_iterator it;
+	for(it = files.begin(); it != files.end(); ++it)
+	{
+		hashU32(h, it->first.size());
+		hashBytes(h, it->first.data(), it->first.size());
+	}
+
+	return h;
+}
+
+std::string AssemblyCache::getPath(sf::Uint64 key) const
+{
+	char name[32];
+	std::sprintf(name, "%08lx%08lx.dcache",
+		static_cast<unsigned long>(key >> 32),
+		static_cast<unsigned long>(key & 0xffffffff));
+	return m_dir + name;
+}
+
+bool AssemblyCache::load(sf::Uint64 key, AssembledProgram & program) const
+{
+	std::ifstream ifs(getPath(key).c_str(), std::ios::in|std::ios::binary);
+	if(!ifs.good())
+		return false;
+
+	char magic[4];
+	u32 version, keyLow, keyHigh, imageSize, labelCount;
+	if(!ifs.read(magic, 4)
+		|| !std::equal(magic, magic + 4, s_magic)
+		|| !readU32(ifs, version) || version != DCPU_ASSEMBLY_CACHE_VERSION
+		|| !readU32(ifs, keyLow) || !readU32(ifs, keyHigh)
+		|| keyLow != (key & 0xffffffff) || keyHigh != (key >> 32)
+		|| !readU32(ifs, imageSize) || imageSize > DCPU_RAM_SIZE)
+		return false;
+
+	program.image.resize(imageSize);
+	for(u32 i = 0; i < imageSize; ++i)
+	{
+		if(!readU16(ifs, program.image[i]))
+			return false;
+	}
+
+	if(!readU32(ifs, labelCount))
+		return false;
+
+	program.labelNames.resize(labelCount);
+	program.labelAddresses.resize(labelCount);
+	for(u32 i = 0; i < labelCount; ++i)
+	{
+		u16 size;
+		if(!readU16(ifs, program.labelAddresses[i]) || !readU16(ifs, size))
+			return false;
+		std::string & name = program.labelNames[i];
+		name.resize(size);
+		if(size != 0 && !ifs.read(&name[0], size))
+			return false;
+	}
+
+	return true;
+}
+
+bool AssemblyCache::save(sf::Uint64 key, const AssembledProgram & program) const
+{
+	const std::string path = getPath(key);
+
+	// Readers must never see a half-written file
+	std::stringstream tmp;
+	tmp << path << "." << getpid() << ".tmp";
+	const std::string tmpPath = tmp.str();
+
+	std::ofstream ofs(tmpPath.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+	if(!ofs.good())
+		return false;
+
+	ofs.write(s_magic, 4);
+	writeU32(ofs, DCPU_ASSEMBLY_CACHE_VERSION);
+	writeU32(ofs, key & 0xffffffff);
+	writeU32(ofs, key >> 32);
+
+	writeU32(ofs, program.image.size());
+	for(u32 i = 0; i < program.image.size(); ++i)
+		writeU16(ofs, program.image[i]);
+
+	writeU32(ofs, program.labelNames.size());
+	for(u32 i = 0; i < program.labelNames.size(); ++i)
+	{
+		const std::string & name = program.labelNames[i];
+		writeU16(ofs, program.labelAddresses[i]);
+		writeU16(ofs, name.size());
+		ofs.write(name.data(), name.size());
+	}
+
+	ofs.close();
+	if(!ofs)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+
+#ifdef WINDOWS
+	// rename doesn't replace existing files
+	std::remove(path.c_str());
+#endif
+	if(std::rename(tmpPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tmpPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+} // namespace dcpu
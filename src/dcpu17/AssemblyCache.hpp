@@ -0,0 +1,73 @@
+#ifndef HEADER_DCPU_ASSEMBLYCACHE_HPP_INCLUDED
+#define HEADER_DCPU_ASSEMBLYCACHE_HPP_INCLUDED
+
+#include <map>
+#include <string>
+#include <vector>
+#include <SFML/System.hpp>
+
+#include "ObjectFile.hpp"
+#include "Preprocessor.hpp"
+
+// Must be incremented when the format of cache files changes
+#define DCPU_ASSEMBLY_CACHE_VERSION 1
+
+namespace dcpu
+{
+// An assembled program, as stored in the cache
+struct AssembledProgram
+{
+	std::vector<u16> image; // Memory from address 0 (trailing zeros are not stored)
+	std::vector<std::string> labelNames;
+	std::vector<u16> labelAddresses; // Same order as labelNames
+
+	// Takes an assembled program (not relocatable, so it has no import)
+	void set(const ObjectFile & object);
+
+	// Copies the image to a full DCPU memory
+	void getMemory(u16 ram[DCPU_RAM_SIZE]) const;
+};
+
+/*
+	Assembled programs saved in a directory, so a program whose sources
+	didn't change is not assembled again.
+
+	A program is identified by a key computed from its preprocessed tokens
+	and the paths of the files it includes (the assembler version is also
+	part of it). The program still has to be preprocessed, but this is
+	much faster than assembling it, and catches changes in included files
+	or macros. Each program is stored in <dir>/<key>.dcache.
+
+	Several processes can use the same directory: files are written
+	under a temporary name, then renamed.
+*/
+class AssemblyCache
+{
+public :
+
+	AssemblyCache(const std::string & dir);
+
+	// Computes the key of a preprocessed program.
+	// files are the included files, as given by the Preprocessor.
+	static sf::Uint64 computeKey(
+		const std::vector<Token> & tokens,
+		const std::map<std::string, IncludedFile> & files);
+
+	// Loads a program from the cache.
+	// Returns false if it is not there (or the file is not valid).
+	bool load(sf::Uint64 key, AssembledProgram & program) const;
+
+	// Saves a program in the cache. Returns false if an error occurred.
+	bool save(sf::Uint64 key, const AssembledProgram & program) const;
+
+private :
+
+	// Path of the cache file of a key
+	std::string getPath(sf::Uint64 key) const;
+
+	std::string m_dir;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_ASSEMBLYCACHE_HPP_INCLUDED
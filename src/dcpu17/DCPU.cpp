@@ -14,6 +14,7 @@ u16 DCPU::getMemory(u16 addr) const
 void DCPU::setMemory(u16 addr, u16 val)
 {
 	m_ram[addr] = val;
+	onStore(m_ram + addr);
 }
 
 void DCPU::setMemory(const u16 ram[DCPU_RAM_SIZE])
@@ -21,7 +22,10 @@ void DCPU::setMemory(const u16 ram[DCPU_RAM_SIZE])
 	// TODO DCPU: change back to memcpy (previously changed for debug purpose)
 	//memcpy(m_ram, ram, DCPU_RAM_SIZE * sizeof(u16));
 	for(u32 i = 0; i < DCPU_RAM_SIZE; i++)
+	{
 		m_ram[i] = ram[i];
+		onStore(m_ram + i);
+	}
 }
 
 // Numbers from -1 to 30
@@ -197,6 +201,10 @@ void DCPU::step()
 	if(m_broken)
 		return;
 
+	// Run device events which deadline is reached
+	if(m_scheduler.isDue(m_cycles))
+		m_scheduler.run(m_cycles);
+
 	if(m_haltCycles > 0)
 	{
 		--m_haltCycles;
@@ -213,8 +221,9 @@ void DCPU::step()
 	else
 		extendedOp(op);
 
-	// Perform queued interrupts
-	if(!m_intQueueEmpty)
+	// Perform queued interrupts (one per instruction,
+	// when the previous one is handled)
+	if(m_intQueueSize != 0 && !m_intQueueing)
 	{
 		u16 msg = 0;
 		if(popInterrupt(msg))
@@ -222,6 +231,60 @@ void DCPU::step()
 	}
 }
 
+u32 DCPU::getWaitLoopCost() const
+{
+	if(m_broken || m_haltCycles != 0 || m_intQueueSize != 0)
+		return 0;
+
+	const u16 op = m_ram[m_pc];
+	if(!isBasicOp(op) || decodeB(op) != AD_PC)
+		return 0;
+
+	const u8 opcode = decodeOp(op);
+	const u8 a = decodeA(op);
+	const u16 next = (m_pc + 1) & 0xffff;
+
+	if(opcode == OP_SET)
+	{
+		// SET PC, <here>
+		if(a >= AD_LIT && g_lit[a & 0x1f] == m_pc)
+			return g_opCost[OP_SET];
+		if(a == AD_NEXTWORD && m_ram[next] == m_pc)
+			return g_opCost[OP_SET];
+	}
+	else if(opcode == OP_SUB)
+	{
+		// SUB PC, 1 (only sets EX to 0, so it must already be 0)
+		if(a >= AD_LIT && g_lit[a & 0x1f] == 1 && m_ex == 0)
+			return g_opCost[OP_SUB];
+	}
+
+	return 0;
+}
+
+u32 DCPU::skipWaitLoop(u32 maxCycles)
+{
+	const u32 cost = getWaitLoopCost();
+	if(cost == 0)
+		return 0;
+
+	// Scheduled events must run at the same cycle as if every
+	// iteration was executed
+	if(!m_scheduler.empty())
+	{
+		const u32 untilEvent = (m_scheduler.getNextDeadline() - m_cycles) & 0xffffffff;
+		if(!isCycleAfter(m_scheduler.getNextDeadline(), m_cycles))
+			return 0;
+		if(untilEvent < maxCycles)
+			maxCycles = untilEvent;
+	}
+
+	const u32 iterations = maxCycles / cost;
+	m_steps += iterations;
+	m_cycles += iterations * cost;
+	return iterations * cost;
+}
+
 // Performs the basic operation that have just been read
 void DCPU::basicOp(u16 op)
 {
@@ -411,7 +474,10 @@ void DCPU::basicOp(u16 op)
 	}
 
 	if(b_code < 0x1f)
+	{
 		*b_addr = res & 0xffff;
+		onStore(b_addr);
+	}
 }
 
 // Performs the extended operation that have just been read
@@ -430,6 +496,7 @@ void DCPU::extendedOp(u16 op)
 		// pushes the address of the next instruction to the stack,
 		// then sets PC to a
 		m_ram[--m_sp] = m_pc;
+		onStore(m_ram + m_sp);
 		m_pc = a;
 		return;
 
@@ -440,6 +507,7 @@ void DCPU::extendedOp(u16 op)
 
 	case EOP_IAG:
 		*a_addr = m_ia;
+		onStore(a_addr);
 		return;
 
 	case EOP_IAS:
@@ -451,6 +519,7 @@ void DCPU::extendedOp(u16 op)
 		// and pop A and PC from the stack as a single atomic instruction.
 		m_intQueueing = false;
 		*a_addr = m_ram[m_sp++];
+		onStore(a_addr);
 		m_pc = m_ram[m_sp++];
 		return;
 
@@ -464,6 +533,7 @@ void DCPU::extendedOp(u16 op)
 	case EOP_HWN:
 		// Sets a to number of connected hardware devices
 		*a_addr = m_hardwareDevices.size();
+		onStore(a_addr);
 		return;
 
 	case EOP_HWQ:
@@ -498,7 +568,7 @@ void DCPU::extendedOp(u16 op)
 	case EOP_HWI:
 		// Sends an interrupt to hardware a
 		if(a < m_hardwareDevices.size())
-			m_hardwareDevices[a]->interrupt();
+			m_hardwareDevices[a]->interrupt(m_r);
 #ifdef DCPU_DEBUG
 		else
 			std::cout << "E: Failed to send an interrupt to hardware device "
@@ -528,7 +598,7 @@ void DCPU::interrupt(u16 msg)
 	{
 		// Interrupts are queued
 		if(!pushInterrupt(msg))
-			return; // Error
+			return; // Dropped
 	}
 	else
 	{
@@ -538,52 +608,62 @@ void DCPU::interrupt(u16 msg)
 #endif
 		m_intQueueing = true;
 		m_ram[--m_sp] = m_pc;
+		onStore(m_ram + m_sp);
 		m_ram[--m_sp] = m_r[AD_A];
+		onStore(m_ram + m_sp);
 		m_pc = m_ia;
 		m_r[AD_A] = msg;
 	}
 }
 
 // Push one interrupt to the queue. Returns false if overflow.
+// The specification says the DCPU catches fire on overflow, but that
+// kills programs that just can't keep up with a fast device: the
+// interrupt is dropped and counted instead.
 bool DCPU::pushInterrupt(u16 msg)
 {
-	if(m_intQueueEmpty)
-	{
-		m_intQueueEmpty = false;
-		m_intQueuePos = 0;
-	}
-	else
-		++m_intQueuePos;
-
-	if(m_intQueuePos == DCPU_INTQ_SIZE)
+	if(m_intQueueSize == DCPU_INTQ_SIZE)
 	{
 #ifdef DCPU_DEBUG
-		std::cout << "E: Interrupts queue overflow" << std::endl;
+		if(m_droppedInterrupts == 0)
+			std::cout << "E: Interrupts queue overflow, interrupts are dropped" << std::endl;
 #endif
-		setBroken(true);
+		++m_droppedInterrupts;
 		return false;
 	}
-	msg = m_intQueue[m_intQueuePos];
+
+	m_intQueue[(m_intQueueStart + m_intQueueSize) % DCPU_INTQ_SIZE] = msg;
+	++m_intQueueSize;
+	if(m_intQueueSize > m_intQueuePeak)
+		m_intQueuePeak = m_intQueueSize;
 	return true;
 }
 
 // Pops one interrupt from the queue. Returns false if the queue is empty.
 bool DCPU::popInterrupt(u16 & msg)
 {
-	if(m_intQueueEmpty)
+	if(m_intQueueSize == 0)
 		return false;
 
-	msg = m_intQueue[m_intQueuePos];
-	m_intQueue[m_intQueuePos] = 0;
+	msg = m_intQueue[m_intQueueStart];
+	m_intQueue[m_intQueueStart] = 0;
 
-	if(m_intQueuePos == 0)
-		m_intQueueEmpty = true;
-	else
-		--m_intQueuePos;
+	m_intQueueStart = (m_intQueueStart + 1) % DCPU_INTQ_SIZE;
+	--m_intQueueSize;
 
 	return true;
 }
 
+bool DCPU::isInterruptQueued(u16 msg) const
+{
+	for(u16 i = 0; i < m_intQueueSize; ++i)
+	{
+		if(m_intQueue[(m_intQueueStart + i) % DCPU_INTQ_SIZE] == msg)
+			return true;
+	}
+	return false;
+}
+
 // Connects a hardware device and returns its index.
 // Does nothing if it is already connected.
 u16 DCPU::connectHardware(IHardwareDevice * hd)
@@ -640,7 +720,9 @@ void DCPU::printState(std::ostream & os)
 	os << "SP = " << FORMAT_HEX(m_sp) << "\n";
 	os << "EX = " << FORMAT_HEX(m_ex) << "\n";
 	os << "IA = " << FORMAT_HEX(m_ia) << "\n";
-	os << "Queued interrupts = " << m_intQueuePos << "\n";
+	os << "Queued interrupts = " << m_intQueueSize
+		<< " (peak " << m_intQueuePeak
+		<< ", dropped " << m_droppedInterrupts << ")\n";
 	os << "Connected HDs = " << m_hardwareDevices.size() << "\n";
 	os << "Steps = " << m_steps << "\n";
 	os << "Cycles = " << m_cycles << "\n";
@@ -13,6 +13,8 @@
 
 #include "common.hpp"
 #include "IHardwareDevice.hpp"
+#include "MemoryBus.hpp"
+#include "Scheduler.hpp"
 
 #define DCPU_REG_COUNT 8
 #define DCPU_RAM_SIZE 65536
@@ -50,15 +52,27 @@ public :
 		m_haltCycles = 0;
 		m_intQueueing = false;
 		memset(m_intQueue, 0, DCPU_INTQ_SIZE * sizeof(u16));
-		m_intQueuePos = 0;
-		m_intQueueEmpty = true;
+		m_intQueueStart = 0;
+		m_intQueueSize = 0;
+		m_intQueuePeak = 0;
+		m_droppedInterrupts = 0;
 		m_broken = false;
 	}
 
 	// Executes one instruction
 	void step();
 
-	// RAM access
+	// Returns true if the DCPU can't do anything until an interrupt:
+	// it is on a jump to itself (SET PC, <here> or SUB PC, 1)
+	// with no queued interrupt and no halt cycles left.
+	bool isWaiting() const { return getWaitLoopCost() != 0; }
+
+	// If the DCPU is waiting, advances the cycle counter by whole
+	// iterations of the wait loop, within maxCycles and without going
+	// past the next scheduled event. Returns the number of cycles skipped.
+	u32 skipWaitLoop(u32 maxCycles);
+
+	// RAM access (setMemory() is seen by memory-mapped devices)
 	u16 getMemory(u16 addr) const;
 	const u16 * getMemory() const { return m_ram; }
 	void setMemory(u16 addr, u16 val);
@@ -66,6 +80,7 @@ public :
 
 	// Getters
 	u16 getRegister(u8 i) const { return m_r[i]; }
+	RegisterFile & getRegisters() { return m_r; }
 	u16 getSP() const { return m_sp; }
 	u16 getPC() const { return m_pc; }
 	u16 getEX() const { return m_ex; }
@@ -77,6 +92,13 @@ public :
 
 	bool isBroken() const { return m_broken; }
 
+	// Events timed in DCPU cycles (used by hardware devices)
+	Scheduler & getScheduler() { return m_scheduler; }
+	const Scheduler & getScheduler() const { return m_scheduler; }
+
+	// Memory-mapped devices (see MemoryBus)
+	MemoryBus & getBus() { return m_bus; }
+
 	// Setters
 	void setBroken(bool b);
 	void setRegister(u8 i, u16 value) { m_r[i] = value; }
@@ -87,6 +109,18 @@ public :
 	// Triggers in interrupt with message msg
 	void interrupt(u16 msg);
 
+	// Returns true if an interrupt with message msg is waiting in the queue
+	bool isInterruptQueued(u16 msg) const;
+
+	// Number of interrupts waiting in the queue
+	u16 getQueuedInterrupts() const { return m_intQueueSize; }
+
+	// Largest number of interrupts that waited in the queue at once
+	u16 getInterruptQueuePeak() const { return m_intQueuePeak; }
+
+	// Number of interrupts lost because the queue was full
+	u32 getDroppedInterrupts() const { return m_droppedInterrupts; }
+
 	// Halts the DCPU for ncycles
 	void halt(u32 ncycles) { m_haltCycles += ncycles; }
 
@@ -103,6 +137,14 @@ private :
 	// Evaluates next operand
 	u16 * operand(u16 code, bool isB);
 
+	// Tells memory-mapped devices that the word at p was stored.
+	// p may also be a register, which is not mapped.
+	void onStore(const u16 * p)
+	{
+		if(p >= m_ram && p < m_ram + DCPU_RAM_SIZE && m_bus.isMapped(p - m_ram))
+			m_bus.write(p - m_ram, *p);
+	}
+
 	// Skips one instruction
 	void skip(bool fromIF);
 
@@ -112,6 +154,10 @@ private :
 	// Performs the extended operation that have just been read
 	void extendedOp(u16 op);
 
+	// Cycles taken by one iteration of the wait loop at PC,
+	// or 0 if the DCPU is not waiting (see isWaiting())
+	u32 getWaitLoopCost() const;
+
 	// Push one interrupt to the queue. Returns false if overflow.
 	bool pushInterrupt(u16 msg);
 
@@ -121,7 +167,7 @@ private :
 	// Attributes
 
 	u16 m_ram[DCPU_RAM_SIZE];   // Memory
-	u16 m_r[DCPU_REG_COUNT];    // Registers
+	RegisterFile m_r;           // Registers
 	u16 m_sp;       // Stack pointer
 	u16 m_pc;       // Program counter
 	u16 m_ex;       // Overflow
@@ -132,14 +178,20 @@ private :
 	u32 m_haltCycles;   // Sleep cycles
 
 	bool m_intQueueing;             // Is interrupt queueing enabled?
-	u16 m_intQueue[DCPU_INTQ_SIZE]; // Interrupts queue
-	u16 m_intQueuePos;              // Current position in intQueue
-	bool m_intQueueEmpty;
+	u16 m_intQueue[DCPU_INTQ_SIZE]; // Interrupts queue (FIFO)
+	u16 m_intQueueStart;            // Position of the oldest interrupt
+	u16 m_intQueueSize;             // Number of queued interrupts
+	u16 m_intQueuePeak;             // Highest m_intQueueSize
+	u32 m_droppedInterrupts;        // Interrupts lost on overflow
 
 	bool m_broken;  // True if the CPU cannot work (step() will do nothing)
 
 	std::vector<IHardwareDevice*> m_hardwareDevices;
 
+	Scheduler m_scheduler; // Cycle-timed events
+
+	MemoryBus m_bus; // Memory-mapped devices
+
 };
 
 
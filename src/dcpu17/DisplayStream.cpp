@@ -0,0 +1,536 @@
+#include "DisplayStream.hpp"
+
+#ifndef WINDOWS
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+	#define MSG_NOSIGNAL 0
+#endif
+
+// Where the viewer maps the LEM1802 in its DCPU
+#define DCPU_VIEWER_VRAM_ADDR 0x1000
+#define DCPU_VIEWER_FONT_ADDR 0x2000
+#define DCPU_VIEWER_PALETTE_ADDR 0x3000
+
+namespace dcpu
+{
+// Unsent changes of two words or less cost less than a new run
+#define DCPU_DISPLAY_STREAM_RUN_GAP 2
+
+inline void putWord(std::vector<u8> & buf, u16 w)
+{
+	buf.push_back(w & 0xff);
+	buf.push_back((w >> 8) & 0xff);
+}
+
+inline void putWords(std::vector<u8> & buf, const u16 * words, u32 count)
+{
+	for(u32 i = 0; i < count; ++i)
+		putWord(buf, words[i]);
+}
+
+inline void putHeader(std::vector<u8> & buf, u16 type, u16 size)
+{
+	putWord(buf, type);
+	putWord(buf, size);
+}
+
+// -----------------------------------------------------------------------------
+// DisplayStream
+// -----------------------------------------------------------------------------
+
+DisplayStream::DisplayStream()
+{
+	r_dcpu = 0;
+	r_lem = 0;
+	m_fd = -1;
+	m_interval = 0;
+	m_sentBytes = 0;
+	m_border = 0;
+	m_lastBorder = 0;
+}
+
+DisplayStream::~DisplayStream()
+{
+	stop();
+}
+
+bool DisplayStream::start(DCPU & dcpu, LEM1802 & lem, const std::string & path, u32 interval)
+{
+	stop();
+
+#ifdef WINDOWS
+	std::cout << "E: DisplayStream: not supported on this platform" << std::endl;
+	return false;
+#else
+	if(interval == 0)
+	{
+		std::cout << "E: DisplayStream: the interval must not be zero" << std::endl;
+		return false;
+	}
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path))
+	{
+		std::cout << "E: DisplayStream: socket path is too long" << std::endl;
+		return false;
+	}
+	strcpy(addr.sun_path, path.c_str());
+
+	m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(m_fd < 0)
+	{
+		std::cout << "E: DisplayStream: couldn't create socket" << std::endl;
+		return false;
+	}
+
+	unlink(path.c_str()); // Left by a previous run
+	if(bind(m_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(m_fd, 4) < 0)
+	{
+		std::cout << "E: DisplayStream: couldn't listen on '" << path << "'" << std::endl;
+		close(m_fd);
+		m_fd = -1;
+		return false;
+	}
+	fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+	r_dcpu = &dcpu;
+	r_lem = &lem;
+	m_path = path;
+	m_interval = interval;
+	m_sentBytes = 0;
+
+	r_dcpu->getScheduler().schedule(this, r_dcpu->getCycles() + m_interval);
+
+	std::cout << "I: DisplayStream: publishing on '" << path << "'" << std::endl;
+	return true;
+#endif
+}
+
+void DisplayStream::stop()
+{
+	if(r_dcpu == 0)
+		return;
+
+	r_dcpu->getScheduler().cancel(this);
+	r_dcpu = 0;
+	r_lem = 0;
+
+#ifndef WINDOWS
+	for(u32 i = 0; i < m_clients.size(); ++i)
+		close(m_clients[i].fd);
+	m_clients.clear();
+
+	close(m_fd);
+	m_fd = -1;
+	unlink(m_path.c_str());
+#endif
+
+	std::cout << "I: DisplayStream: stopped, " << m_sentBytes << " bytes sent" << std::endl;
+}
+
+void DisplayStream::onScheduledEvent(u16 id, u32 cycle)
+{
+	if(r_dcpu == 0)
+		return;
+
+	publish();
+
+	r_dcpu->getScheduler().schedule(this, cycle + m_interval);
+}
+
+void DisplayStream::readState()
+{
+	memcpy(m_palette, r_lem->getPalette(), 16 * sizeof(u16));
+	memcpy(m_font, r_lem->getFont(), DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+	m_border = r_lem->getBorderColorIndex();
+
+	const u16 addr = r_lem->getVRAMAddr();
+	for(u32 i = 0; i < DCPU_LEM1802_VRAM_SIZE; ++i)
+	{
+		// A disconnected screen is sent as a blank one
+		m_vram[i] = addr != 0 && addr + i < DCPU_RAM_SIZE ?
+			r_dcpu->getMemory(addr + i) : 0;
+	}
+}
+
+void DisplayStream::writeKeyframe(std::vector<u8> & buf) const
+{
+	putHeader(buf, DSM_KEYFRAME, 1 + 16 + DCPU_LEM1802_FONT_SIZE + DCPU_LEM1802_VRAM_SIZE);
+	putWord(buf, m_border);
+	putWords(buf, m_palette, 16);
+	putWords(buf, m_font, DCPU_LEM1802_FONT_SIZE);
+	putWords(buf, m_vram, DCPU_LEM1802_VRAM_SIZE);
+}
+
+void DisplayStream::writeDiff(std::vector<u8> & buf) const
+{
+	if(m_border != m_lastBorder)
+	{
+		putHeader(buf, DSM_BORDER, 1);
+		putWord(buf, m_border);
+	}
+
+	if(memcmp(m_palette, m_lastPalette, 16 * sizeof(u16)) != 0)
+	{
+		putHeader(buf, DSM_PALETTE, 16);
+		putWords(buf, m_palette, 16);
+	}
+
+	if(memcmp(m_font, m_lastFont, DCPU_LEM1802_FONT_SIZE * sizeof(u16)) != 0)
+	{
+		putHeader(buf, DSM_FONT, DCPU_LEM1802_FONT_SIZE);
+		putWords(buf, m_font, DCPU_LEM1802_FONT_SIZE);
+	}
+
+	// Runs of changed VRAM words
+	std::vector<u8> runs;
+	u32 i = 0;
+	while(i < DCPU_LEM1802_VRAM_SIZE)
+	{
+		if(m_vram[i] == m_lastVram[i])
+		{
+			++i;
+			continue;
+		}
+
+		// Extend the run while changes are close enough
+		u32 end = i + 1;
+		u32 last = i;
+		while(end < DCPU_LEM1802_VRAM_SIZE && end - last <= DCPU_DISPLAY_STREAM_RUN_GAP + 1)
+		{
+			if(m_vram[end] != m_lastVram[end])
+				last = end;
+			++end;
+		}
+
+		putWord(runs, i);
+		putWord(runs, last + 1 - i);
+		putWords(runs, m_vram + i, last + 1 - i);
+		i = last + 1;
+	}
+
+	if(!runs.empty())
+	{
+		putHeader(buf, DSM_VRAM, runs.size() / 2);
+		buf.insert(buf.end(), runs.begin(), runs.end());
+	}
+}
+
+void DisplayStream::publish()
+{
+#ifndef WINDOWS
+	// Accept new viewers
+	int fd;
+	while((fd = accept(m_fd, 0, 0)) >= 0)
+	{
+		if(m_clients.size() >= DCPU_DISPLAY_STREAM_MAX_CLIENTS)
+		{
+			close(fd);
+			continue;
+		}
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+		Client client;
+		client.fd = fd;
+		client.needsKeyframe = true;
+		m_clients.push_back(client);
+#ifdef DCPU_DEBUG
+		std::cout << "I: DisplayStream: viewer connected" << std::endl;
+#endif
+	}
+
+	if(m_clients.empty())
+		return;
+
+	readState();
+
+	// Messages are built once for all viewers
+	std::vector<u8> diff;
+	std::vector<u8> keyframe;
+	writeDiff(diff);
+
+	for(u32 i = 0; i < m_clients.size(); )
+	{
+		Client & client = m_clients[i];
+		bool ok = true;
+
+		// Finish the previous message first
+		if(!client.pending.empty())
+		{
+			std::vector<u8> pending;
+			pending.swap(client.pending);
+			ok = send(client, &pending[0], pending.size());
+			if(ok && !client.pending.empty())
+				client.needsKeyframe = true; // Too slow, it will need a resync
+		}
+
+		if(ok && client.pending.empty())
+		{
+			if(client.needsKeyframe)
+			{
+				if(keyframe.empty())
+					writeKeyframe(keyframe);
+				client.needsKeyframe = false;
+				ok = send(client, &keyframe[0], keyframe.size());
+			}
+			else if(!diff.empty())
+				ok = send(client, &diff[0], diff.size());
+		}
+
+		if(ok)
+			++i;
+		else
+		{
+#ifdef DCPU_DEBUG
+			std::cout << "I: DisplayStream: viewer disconnected" << std::endl;
+#endif
+			close(client.fd);
+			m_clients.erase(m_clients.begin() + i);
+		}
+	}
+
+	memcpy(m_lastVram, m_vram, DCPU_LEM1802_VRAM_SIZE * sizeof(u16));
+	memcpy(m_lastPalette, m_palette, 16 * sizeof(u16));
+	memcpy(m_lastFont, m_font, DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+	m_lastBorder = m_border;
+#endif
+}
+
+bool DisplayStream::send(Client & client, const u8 * data, u32 size)
+{
+#ifdef WINDOWS
+	return false;
+#else
+	u32 sent = 0;
+	while(sent < size)
+	{
+		ssize_t n = ::send(client.fd, data + sent, size - sent, MSG_NOSIGNAL);
+		if(n < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			return false;
+		}
+		sent += n;
+	}
+	m_sentBytes += sent;
+
+	// Keep the rest, a message must never be cut
+	if(sent < size)
+		client.pending.assign(data + sent, data + size);
+	return true;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+// DisplayStreamViewer
+// -----------------------------------------------------------------------------
+
+DisplayStreamViewer::DisplayStreamViewer()
+{
+	m_fd = -1;
+}
+
+DisplayStreamViewer::~DisplayStreamViewer()
+{
+#ifndef WINDOWS
+	if(m_fd >= 0)
+		close(m_fd);
+#endif
+}
+
+bool DisplayStreamViewer::connect(const std::string & path)
+{
+#ifdef WINDOWS
+	std::cout << "E: DisplayStreamViewer: not supported on this platform" << std::endl;
+	return false;
+#else
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.size() >= sizeof(addr.sun_path))
+	{
+		std::cout << "E: DisplayStreamViewer: socket path is too long" << std::endl;
+		return false;
+	}
+	strcpy(addr.sun_path, path.c_str());
+
+	m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(m_fd < 0 || ::connect(m_fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+	{
+		std::cout << "E: DisplayStreamViewer: couldn't connect to '" << path << "'" << std::endl;
+		return false;
+	}
+	fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+
+	// Map the screen like a program would do
+	m_lem.connect(m_dcpu);
+	mapLEM(LEM1802::MEM_MAP_SCREEN, DCPU_VIEWER_VRAM_ADDR);
+	mapLEM(LEM1802::MEM_MAP_PALETTE, DCPU_VIEWER_PALETTE_ADDR);
+
+	return true;
+#endif
+}
+
+void DisplayStreamViewer::mapLEM(u16 code, u16 b)
+{
+	RegisterFile r = {0};
+	r[AD_A] = code;
+	r[AD_B] = b;
+	m_lem.interrupt(r);
+}
+
+void DisplayStreamViewer::applyMessage(u16 type, const std::vector<u16> & payload)
+{
+	const u32 size = payload.size();
+
+	switch(type)
+	{
+	case DSM_KEYFRAME:
+		if(size != 1 + 16 + DCPU_LEM1802_FONT_SIZE + DCPU_LEM1802_VRAM_SIZE)
+			break;
+		mapLEM(LEM1802::SET_BORDER_COLOR, payload[0]);
+		for(u32 i = 0; i < 16; ++i)
+			m_dcpu.setMemory(DCPU_VIEWER_PALETTE_ADDR + i, payload[1 + i]);
+		for(u32 i = 0; i < DCPU_LEM1802_FONT_SIZE; ++i)
+			m_dcpu.setMemory(DCPU_VIEWER_FONT_ADDR + i, payload[17 + i]);
+		mapLEM(LEM1802::MEM_MAP_FONT, DCPU_VIEWER_FONT_ADDR);
+		for(u32 i = 0; i < DCPU_LEM1802_VRAM_SIZE; ++i)
+			m_dcpu.setMemory(DCPU_VIEWER_VRAM_ADDR + i, payload[17 + DCPU_LEM1802_FONT_SIZE + i]);
+		break;
+
+	case DSM_VRAM:
+		for(u32 i = 0; i + 2 <= size; )
+		{
+			const u16 first = payload[i];
+			const u16 count = payload[i+1];
+			i += 2;
+			for(u16 j = 0; j < count && i < size; ++j, ++i)
+			{
+				if(first + j < DCPU_LEM1802_VRAM_SIZE)
+					m_dcpu.setMemory(DCPU_VIEWER_VRAM_ADDR + first + j, payload[i]);
+			}
+		}
+		break;
+
+	case DSM_PALETTE:
+		for(u32 i = 0; i < 16 && i < size; ++i)
+			m_dcpu.setMemory(DCPU_VIEWER_PALETTE_ADDR + i, payload[i]);
+		break;
+
+	case DSM_FONT:
+		for(u32 i = 0; i < DCPU_LEM1802_FONT_SIZE && i < size; ++i)
+			m_dcpu.setMemory(DCPU_VIEWER_FONT_ADDR + i, payload[i]);
+		mapLEM(LEM1802::MEM_MAP_FONT, DCPU_VIEWER_FONT_ADDR);
+		break;
+
+	case DSM_BORDER:
+		if(size >= 1)
+			mapLEM(LEM1802::SET_BORDER_COLOR, payload[0]);
+		break;
+
+	default:
+#ifdef DCPU_DEBUG
+		std::cout << "E: DisplayStreamViewer: unknown message " << type << std::endl;
+#endif
+		break;
+	}
+}
+
+bool DisplayStreamViewer::update()
+{
+#ifdef WINDOWS
+	return false;
+#else
+	// Read everything available
+	u8 chunk[4096];
+	while(true)
+	{
+		ssize_t n = recv(m_fd, chunk, sizeof(chunk), 0);
+		if(n > 0)
+			m_buffer.insert(m_buffer.end(), chunk, chunk + n);
+		else if(n == 0)
+			return false; // Closed
+		else if(errno == EINTR)
+			continue;
+		else if(errno == EAGAIN || errno == EWOULDBLOCK)
+			break;
+		else
+			return false;
+	}
+
+	// Decode complete messages
+	u32 pos = 0;
+	std::vector<u16> payload;
+	while(m_buffer.size() - pos >= 4)
+	{
+		const u16 type = m_buffer[pos] | (m_buffer[pos+1] << 8);
+		const u32 size = m_buffer[pos+2] | (m_buffer[pos+3] << 8);
+		if(m_buffer.size() - pos < 4 + 2 * size)
+			break;
+
+		payload.resize(size);
+		const u8 * p = &m_buffer[pos + 4];
+		for(u32 i = 0; i < size; ++i)
+			payload[i] = p[2*i] | (p[2*i+1] << 8);
+
+		applyMessage(type, payload);
+		pos += 4 + 2 * size;
+	}
+	m_buffer.erase(m_buffer.begin(), m_buffer.begin() + pos);
+
+	return true;
+#endif
+}
+
+void DisplayStreamViewer::run()
+{
+	int k = 4;
+	sf::VideoMode videoMode(
+		k * (DCPU_LEM1802_W+2),
+		k * (DCPU_LEM1802_H+2));
+
+	m_win.create(videoMode, "DCPU16 display stream");
+	m_win.setFramerateLimit(60);
+
+	sf::View view(sf::FloatRect(-1, -1, DCPU_LEM1802_W+2, DCPU_LEM1802_H+2));
+	m_win.setView(view);
+
+	sf::Event event;
+	while(m_win.isOpen())
+	{
+		while(m_win.pollEvent(event))
+		{
+			if(event.type == sf::Event::Closed)
+				m_win.close();
+		}
+
+		if(!update())
+		{
+			std::cout << "I: DisplayStreamViewer: stream closed" << std::endl;
+			break;
+		}
+
+		// The viewer's DCPU never runs, blink follows real time instead
+		m_dcpu.getScheduler().run(
+			(u32)(m_time.getElapsedTime().asSeconds() * DCPU_STANDARD_FREQUENCY));
+
+		m_win.clear();
+		m_lem.render(m_win);
+		m_win.display();
+	}
+
+	m_lem.disconnect();
+}
+
+} // namespace dcpu
+
@@ -0,0 +1,147 @@
+#ifndef HEADER_DCPU_DISPLAYSTREAM_HPP_INCLUDED
+#define HEADER_DCPU_DISPLAYSTREAM_HPP_INCLUDED
+
+#include <vector>
+#include <SFML/Graphics.hpp>
+
+#include "LEM1802.hpp"
+
+// Max number of viewers connected to one stream
+#define DCPU_DISPLAY_STREAM_MAX_CLIENTS 16
+
+//
+// LEM1802 display stream protocol
+//
+// Everything is made of little-endian 16-bit words.
+// A message is a header of two words (type, payload size in words)
+// followed by its payload:
+//
+// KEYFRAME : border index, 16 palette words, 256 font words, 384 VRAM words
+// VRAM     : runs of changed words, each as (first cell, count, words...)
+// PALETTE  : 16 palette words
+// FONT     : 256 font words
+// BORDER   : border index
+//
+// A keyframe is sent to each viewer when it connects (or when it fell
+// behind), then only what changed is sent.
+//
+
+namespace dcpu
+{
+enum DisplayStreamMessages
+{
+	DSM_KEYFRAME = 1,
+	DSM_VRAM,    // 2
+	DSM_PALETTE, // 3
+	DSM_FONT,    // 4
+	DSM_BORDER   // 5
+};
+
+/*
+	Publishes the state of a LEM1802 on a local (Unix domain) socket,
+	every interval DCPU cycles.
+*/
+class DisplayStream : public IScheduled
+{
+public :
+
+	DisplayStream();
+	~DisplayStream();
+
+	// Creates the socket at path and starts publishing the state of lem.
+	// Returns false if an error occurred.
+	bool start(DCPU & dcpu, LEM1802 & lem, const std::string & path, u32 interval);
+
+	// Disconnects viewers and removes the socket
+	void stop();
+
+	bool isRunning() const { return r_dcpu != 0; }
+
+	// Number of bytes sent since start
+	u32 getSentBytes() const { return m_sentBytes; }
+
+	virtual void onScheduledEvent(u16 id, u32 cycle);
+
+private :
+
+	struct Client
+	{
+		int fd;
+		bool needsKeyframe;
+		std::vector<u8> pending; // Unsent end of the last message
+	};
+
+	// Accepts new viewers, then sends them what changed
+	void publish();
+
+	// Reads the current state of the screen
+	void readState();
+
+	// Appends messages to buf
+	void writeKeyframe(std::vector<u8> & buf) const;
+	void writeDiff(std::vector<u8> & buf) const;
+
+	// Sends data to a client. Returns false if the client must be dropped.
+	bool send(Client & client, const u8 * data, u32 size);
+
+	DCPU * r_dcpu;
+	LEM1802 * r_lem;
+	std::string m_path;
+	int m_fd; // Listening socket
+	u32 m_interval;
+	u32 m_sentBytes;
+	std::vector<Client> m_clients;
+
+	// Current and last published states
+	u16 m_vram[DCPU_LEM1802_VRAM_SIZE];
+	u16 m_palette[16];
+	u16 m_font[DCPU_LEM1802_FONT_SIZE];
+	u16 m_border;
+	u16 m_lastVram[DCPU_LEM1802_VRAM_SIZE];
+	u16 m_lastPalette[16];
+	u16 m_lastFont[DCPU_LEM1802_FONT_SIZE];
+	u16 m_lastBorder;
+
+};
+
+/*
+	Window showing a LEM1802 display stream.
+	Messages are replayed on a local LEM1802, mapped to a DCPU that
+	never runs, so the screen looks exactly like the original.
+*/
+class DisplayStreamViewer
+{
+public :
+
+	DisplayStreamViewer();
+	~DisplayStreamViewer();
+
+	// Connects to a stream. Returns false if it failed.
+	bool connect(const std::string & path);
+
+	// Opens a window and shows the stream until it is closed
+	void run();
+
+private :
+
+	// Reads and applies available messages.
+	// Returns false if the stream was closed.
+	bool update();
+
+	// Applies one message (payload words already decoded)
+	void applyMessage(u16 type, const std::vector<u16> & payload);
+
+	void mapLEM(u16 code, u16 b);
+
+	int m_fd;
+	std::vector<u8> m_buffer; // Received data not processed yet
+	DCPU m_dcpu;
+	LEM1802 m_lem;
+	sf::Clock m_time; // For blinking
+	sf::RenderWindow m_win;
+
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_DISPLAYSTREAM_HPP_INCLUDED
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <cstring>
 
 #include "Emulator.hpp"
 #include "utility.hpp"
@@ -8,38 +9,76 @@
 #define DCPU_EMU_SCREEN_H DCPU_LEM1802_H
 #define DCPU_EMU_FREQUENCY DCPU_STANDARD_FREQUENCY
 
+// Where the window thread maps its copy of the screen
+#define DCPU_EMU_VIEW_VRAM_ADDR    0x1000
+#define DCPU_EMU_VIEW_FONT_ADDR    0x2000
+#define DCPU_EMU_VIEW_PALETTE_ADDR 0x3000
+
 namespace dcpu
 {
 // Loads ressources (images, fonts...).
 // Returns false if it failed.
-bool Emulator::loadContent()
+bool Emulator::loadContent(const std::string & assetsDir)
 {
-	std::string assetsDir = DCPU_ASSETS_DIR;
-	assetsDir += '/';
+	// Embedded overlay font
+	sf::Image charset;
+	LEM1802::decodeFont(g_lem1802DefaultFont, charset);
+	if(!m_overlayCharset.loadFromImage(charset))
+	{
+		std::cout << "E: couldn't create the overlay font texture" << std::endl;
+		return false;
+	}
+	m_overlayCharset.setSmooth(false);
+	m_overlayGlyph.setTexture(m_overlayCharset);
+
+	if(assetsDir.empty())
+		return true;
 
-	std::string assetFilename = assetsDir + "lem1802/charset.png";
-	if(!m_lem.loadDefaultFontFromImage(assetFilename))
+	// Optional asset overrides
+
+	if(!loadAssets(assetsDir))
 		return false;
 
-	assetFilename = assetsDir + "emulator/Courier_New_Bold.ttf";
-	if(!m_font.loadFromFile(assetFilename))
+	const std::string assetFilename = assetsDir + DIR_CHAR + "emulator/Courier_New_Bold.ttf";
+	if(fileExists(assetFilename))
 	{
-		std::cout << "Error: couldn't load asset '"
-			<< assetFilename << "'" << std::endl;
-		return false;
+		if(!m_font.loadFromFile(assetFilename))
+		{
+			std::cout << "Error: couldn't load asset '"
+				<< assetFilename << "'" << std::endl;
+			return false;
+		}
+
+		m_cpuStateText.setFont(m_font);
+		m_cpuStateText.setColor(sf::Color(255,255,255));
+		m_cpuStateText.setScale(0.75, 0.75);
+		m_fontLoaded = true;
 	}
 
-	m_cpuStateText.setFont(m_font);
-	m_cpuStateText.setColor(sf::Color(255,255,255));
-	m_cpuStateText.setScale(0.75, 0.75);
+	return true;
+}
+
+bool Emulator::loadAssets(const std::string & assetsDir)
+{
+	if(assetsDir.empty())
+		return true;
+
+	const std::string assetFilename = assetsDir + DIR_CHAR + "lem1802/charset.png";
+	if(fileExists(assetFilename))
+	{
+		if(!m_lem.loadDefaultFontFromImage(assetFilename))
+			return false;
+	}
 
 	return true;
 }
 
 // Loads a program into the DCPU16
-bool Emulator::loadProgram(const std::string & filename)
+bool Emulator::loadProgram(const std::string & filename,
+	const std::vector<std::string> & includePaths,
+	const std::string & cacheDir)
 {
-	return dcpu::loadProgram(m_dcpu, filename);
+	return dcpu::loadProgram(m_dcpu, filename, includePaths, cacheDir);
 }
 
 bool Emulator::dumpMemory(const std::string & name)
@@ -53,10 +92,12 @@ void Emulator::run()
 {
 	std::cout << "Running emulator..." << std::endl;
 
-	// Connect devices
-	m_lem.connect(m_dcpu);
-	m_keyboard.connect(m_dcpu);
-	m_clock.connect(m_dcpu);
+	connectDevices();
+
+	// The window shows a copy of the screen
+	m_viewLem.connect(m_viewDcpu);
+	mapViewLEM(LEM1802::MEM_MAP_SCREEN, DCPU_EMU_VIEW_VRAM_ADDR);
+	mapViewLEM(LEM1802::MEM_MAP_PALETTE, DCPU_EMU_VIEW_PALETTE_ADDR);
 
 	// Video mode
 	int k = 4;
@@ -72,48 +113,75 @@ void Emulator::run()
 	m_win.setView(dcpuView);
 
 	sf::Event event;
-	sf::Clock timer;
-	float delta = 1.f / 60.f;
+	bool showCPUState = false; // While TAB is held
+
+	// Start the emulation thread
+	publishSnapshot();
+	m_cpuRunning = true;
+	m_cpuThread.launch();
 
 	// Start the main loop
 	while(m_win.isOpen())
 	{
-		// Update the DCPU
-		updateCPU();
-
-		// Update hardware devices
-		m_lem.update(delta);
-		m_clock.update(delta);
+		// Nothing is drawn if nothing happened
+		bool redraw = false;
 
 		// Process events
 		while(m_win.pollEvent(event))
 		{
+			redraw = true;
+
 			// Close window : exit
 			if(event.type == sf::Event::Closed)
 				m_win.close();
 
-			// Print cpu info in the console if F3 is pressed
-			if(event.type == sf::Event::KeyPressed)
+			// TAB shows the CPU state, and its keys don't go to the DCPU
+			if(event.type == sf::Event::KeyPressed || event.type == sf::Event::KeyReleased)
 			{
-				if(event.key.code == sf::Keyboard::Key::F3)
-					m_dcpu.printState(std::cout);
+				if(event.key.code == sf::Keyboard::Key::Tab)
+					showCPUState = event.type == sf::Event::KeyPressed;
 			}
+			else if(event.type == sf::Event::LostFocus)
+				showCPUState = false;
+
+			// F3 prints cpu info in the console (done by the emulation thread)
+			const bool f3 = event.type == sf::Event::KeyPressed
+				&& event.key.code == sf::Keyboard::Key::F3;
+
+			// Releases always go, so the keyboard knows no key stays pressed.
+			// Events are dropped if the emulation thread is too late.
+			if(f3 || !showCPUState
+			|| event.type == sf::Event::KeyReleased
+			|| event.type == sf::Event::LostFocus)
+				m_input.push(event);
+		}
+		m_showCPUState = showCPUState;
 
-			if(!sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Tab))
-				m_keyboard.onEvent(event);
+		// Get the last state of the emulation
+		if(m_snapshots.fetch())
+		{
+			applySnapshot(m_snapshots.front());
+			redraw = true;
+		}
+
+		if(!redraw && !showCPUState)
+		{
+			sf::sleep(sf::milliseconds(DCPU_EMU_IDLE_SLICE));
+			continue;
 		}
 
 		// Clear window's pixels
 		m_win.clear();
 
 		// Draw virtual screen
-		m_lem.render(m_win);
+		if(m_snapshots.front().screenMapped)
+			m_viewLem.render(m_win);
 
-		if(sf::Keyboard::isKeyPressed(sf::Keyboard::Key::Tab))
+		if(showCPUState)
 		{
 			// Draw debug information
 			m_win.setView(m_win.getDefaultView());
-			drawCPUState();
+			drawCPUState(m_snapshots.front());
 			m_win.setView(dcpuView);
 		}
 
@@ -121,31 +189,291 @@ void Emulator::run()
 		m_win.display();
 	}
 
-	// Disconnect devices
-	m_keyboard.disconnect();
-	m_lem.disconnect();
-	m_clock.disconnect();
+	m_cpuRunning = false;
+	m_cpuThread.wait();
+
+	m_viewLem.disconnect();
+	disconnectDevices();
+
+	printDrift();
 
 	std::cout << "Emulator closed." << std::endl;
 }
 
-void Emulator::updateCPU()
+void Emulator::runCPU()
 {
-	float frameTime = 1.f / 60.f;
+	const sf::Time frameTime = sf::seconds(1.f / DCPU_EMU_FRAMERATE);
+	sf::Clock timer;
+	sf::Event event;
 
-	// Expected clock frequency: 100kHz
-	const u32 cycles0 = m_dcpu.getCycles();
-	const u32 cycles1 = cycles0 + DCPU_EMU_FREQUENCY * frameTime;
+	m_pacer.reset();
+	while(m_cpuRunning)
+	{
+		// Input received from the window
+		while(m_input.pop(event))
+		{
+			if(event.type == sf::Event::KeyPressed
+			&& event.key.code == sf::Keyboard::Key::F3)
+				m_dcpu.printState(std::cout);
+
+			m_keyboard.onEvent(event);
+		}
+
+		// Update the DCPU (devices run from its scheduler)
+		updateCPU();
+
+		// Cycles always change, so the window only gets a new snapshot
+		// if the screen changed or if the overlay shows them
+		if(m_lem.takeChanges() || m_showCPUState)
+			publishSnapshot();
+
+		// This thread has its own pace, whatever the window does.
+		// It sleeps longer if the DCPU is idle, unless input comes.
+		sf::Time wait = frameTime - timer.getElapsedTime();
+		const sf::Time idle = getIdleTime();
+		if(idle > wait)
+			waitInput(idle);
+		else if(wait > sf::Time::Zero)
+			sf::sleep(wait);
+		timer.restart();
+	}
+}
+
+sf::Time Emulator::getIdleTime() const
+{
+	if(m_dcpu.isBroken())
+		return sf::milliseconds(DCPU_EMU_MAX_IDLE_WAIT);
+	if(!m_dcpu.isWaiting())
+		return sf::Time::Zero;
+
+	// The DCPU wakes up with the next device event or interrupt
+	sf::Time idle = sf::milliseconds(DCPU_EMU_MAX_IDLE_WAIT);
+
+	const Scheduler & scheduler = m_dcpu.getScheduler();
+	if(!scheduler.empty())
+	{
+		const u32 cycles = (scheduler.getNextDeadline() - m_dcpu.getCycles()) & 0xffffffff;
+		const sf::Time t = sf::microseconds(
+			static_cast<sf::Int64>(cycles) * 1000000 / m_pacer.getFrequency());
+		if(t < idle)
+			idle = t;
+	}
+
+	return idle;
+}
+
+void Emulator::waitInput(sf::Time duration)
+{
+	sf::Clock timer;
+	const bool showCPUState = m_showCPUState;
+	while(m_cpuRunning && m_input.isEmpty() && m_showCPUState == showCPUState)
+	{
+		const sf::Time left = duration - timer.getElapsedTime();
+		if(left <= sf::Time::Zero)
+			break;
+		sf::sleep(left < sf::milliseconds(DCPU_EMU_IDLE_SLICE) ?
+			left : sf::milliseconds(DCPU_EMU_IDLE_SLICE));
+	}
+}
 
-	while(m_dcpu.getCycles() < cycles1)
+void Emulator::publishSnapshot()
+{
+	Snapshot & s = m_snapshots.back();
+
+	const u16 vramAddr = m_lem.getVRAMAddr();
+	s.screenMapped = vramAddr != 0;
+	s.blinkVisible = m_lem.isBlinkVisible();
+	s.border = m_lem.getBorderColorIndex();
+	if(s.screenMapped)
+	{
+		// The screen may go past the end of RAM, like LEM1802::renderPixels()
+		const u16 * ram = m_dcpu.getMemory();
+		for(u32 i = 0; i < DCPU_LEM1802_VRAM_SIZE; ++i)
+			s.vram[i] = vramAddr + i < DCPU_RAM_SIZE ? ram[vramAddr + i] : 0;
+	}
+	memcpy(s.palette, m_lem.getPalette(), 16 * sizeof(u16));
+	memcpy(s.font, m_lem.getFont(), DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+
+	for(u8 i = 0; i < 8; ++i)
+		s.registers[i] = m_dcpu.getRegister(i);
+	s.pc = m_dcpu.getPC();
+	s.sp = m_dcpu.getSP();
+	s.ex = m_dcpu.getEX();
+	s.ia = m_dcpu.getIA();
+	s.cycles = m_dcpu.getCycles();
+	s.haltCycles = m_dcpu.getHaltCycles();
+	s.lag = m_pacer.getLag();
+	s.skippedCycles = m_pacer.getSkippedCycles();
+
+	m_snapshots.publish();
+}
+
+void Emulator::mapViewLEM(u16 code, u16 b)
+{
+	RegisterFile r = {0};
+	r[AD_A] = code;
+	r[AD_B] = b;
+	m_viewLem.interrupt(r);
+}
+
+void Emulator::applySnapshot(const Snapshot & s)
+{
+	for(u32 i = 0; i < DCPU_LEM1802_VRAM_SIZE; ++i)
+		m_viewDcpu.setMemory(DCPU_EMU_VIEW_VRAM_ADDR + i, s.vram[i]);
+
+	// Stores reach the view screen through the DCPU bus
+	for(u32 i = 0; i < 16; ++i)
+		m_viewDcpu.setMemory(DCPU_EMU_VIEW_PALETTE_ADDR + i, s.palette[i]);
+
+	const u16 * font = m_viewDcpu.getMemory() + DCPU_EMU_VIEW_FONT_ADDR;
+	if(memcmp(font, s.font, DCPU_LEM1802_FONT_SIZE * sizeof(u16)) != 0)
 	{
+		for(u32 i = 0; i < DCPU_LEM1802_FONT_SIZE; ++i)
+			m_viewDcpu.setMemory(DCPU_EMU_VIEW_FONT_ADDR + i, s.font[i]);
+	}
+	// (mapped once, the view screen keeps it in sync)
+	if(m_viewLem.isDefaultFont())
+		mapViewLEM(LEM1802::MEM_MAP_FONT, DCPU_EMU_VIEW_FONT_ADDR);
+
+	if(s.border != m_viewLem.getBorderColorIndex())
+		mapViewLEM(LEM1802::SET_BORDER_COLOR, s.border);
+
+	m_viewLem.setBlinkVisible(s.blinkVisible);
+}
+
+void Emulator::runHeadless(u32 cycles)
+{
+	std::cout << "Running emulator (headless)..." << std::endl;
+
+	connectDevices();
+
+	const u32 endCycle = m_dcpu.getCycles() + cycles;
+	while(isCycleAfter(endCycle, m_dcpu.getCycles()))
+	{
+		// Wait loops are fast-forwarded
+		if(m_dcpu.skipWaitLoop((endCycle - m_dcpu.getCycles()) & 0xffffffff) != 0)
+			continue;
+
 		m_dcpu.step();
 		if(m_dcpu.isBroken())
 			break;
 	}
+
+	disconnectDevices();
+
+	std::cout << "Emulator stopped after " << cycles << " cycles." << std::endl;
+}
+
+bool Emulator::runTerminal(TerminalRenderer::ColorMode colorMode)
+{
+	TerminalRenderer terminal;
+	if(!terminal.open(colorMode))
+		return false;
+
+	connectDevices();
+
+	const sf::Time frameTime = sf::seconds(1.f / DCPU_EMU_FRAMERATE);
+	sf::Clock timer;
+
+	m_pacer.reset();
+	while(terminal.processInput(m_keyboard))
+	{
+		updateCPU();
+		if(m_dcpu.isBroken())
+			break;
+
+		terminal.render(m_lem, m_dcpu);
+
+		// Nothing else to do until the next frame (or longer if
+		// the DCPU is idle), unless a key is pressed
+		sf::Time wait = frameTime - timer.getElapsedTime();
+		const sf::Time idle = getIdleTime();
+		if(idle > wait)
+			wait = idle;
+		if(wait > sf::Time::Zero)
+			terminal.waitInput(wait.asMilliseconds());
+		timer.restart();
+	}
+
+	terminal.close();
+	disconnectDevices();
+
+	printDrift();
+	std::cout << "Emulator stopped." << std::endl;
+	return true;
 }
 
-void Emulator::drawCPUState()
+bool Emulator::startCapture(FrameCapture::Format format,
+	const std::string & filename, u32 interval)
+{
+	return m_capture.start(m_dcpu, m_lem, format, filename, interval);
+}
+
+bool Emulator::startDisplayStream(const std::string & path, u32 interval)
+{
+	return m_stream.start(m_dcpu, m_lem, path, interval);
+}
+
+bool Emulator::startKeyScript(const std::string & path)
+{
+	return m_keyScript.start(m_dcpu, m_keyboard, path);
+}
+
+void Emulator::connectDevices()
+{
+	m_lem.connect(m_dcpu);
+	m_keyboard.connect(m_dcpu);
+	m_clock.connect(m_dcpu);
+}
+
+void Emulator::disconnectDevices()
+{
+	// Pending frames are written before the screen goes away
+	m_capture.stop();
+	m_stream.stop();
+	m_keyScript.stop();
+
+	m_keyboard.disconnect();
+	m_lem.disconnect();
+	m_clock.disconnect();
+}
+
+void Emulator::updateCPU()
+{
+	// Expected clock frequency: 100kHz, whatever the time since last update
+	const u32 budget = m_pacer.getCycleBudget();
+	const u32 cycles0 = m_dcpu.getCycles();
+	const u32 cycles1 = cycles0 + budget;
+
+	while(isCycleAfter(cycles1, m_dcpu.getCycles()))
+	{
+		// A waiting DCPU costs nothing to run
+		if(m_dcpu.skipWaitLoop((cycles1 - m_dcpu.getCycles()) & 0xffffffff) != 0)
+			continue;
+
+		m_dcpu.step();
+		if(m_dcpu.isBroken())
+		{
+			// Not the host's fault, so not counted as drift
+			m_pacer.consume(budget);
+			return;
+		}
+	}
+
+	// The last instruction may have gone past the budget
+	m_pacer.consume((m_dcpu.getCycles() - cycles0) & 0xffffffff);
+}
+
+void Emulator::printDrift()
+{
+	if(m_pacer.getSkippedCycles() != 0)
+	{
+		std::cout << "I: Emulator: " << m_pacer.getSkippedCycles()
+			<< " cycles skipped to keep up with real time" << std::endl;
+	}
+}
+
+void Emulator::drawCPUState(const Snapshot & s)
 {
 	std::string text;
 	char hex[5] = {'0','0','0','0', 0};
@@ -153,74 +481,118 @@ void Emulator::drawCPUState()
 	// Registers
 
 	text += "A=";
-	u16ToHexStr(m_dcpu.getRegister(0), hex);
+	u16ToHexStr(s.registers[0], hex);
 	text += hex;
 
 	text += " B=";
-	u16ToHexStr(m_dcpu.getRegister(1), hex);
+	u16ToHexStr(s.registers[1], hex);
 	text += hex;
 
 	text += " C=";
-	u16ToHexStr(m_dcpu.getRegister(2), hex);
+	u16ToHexStr(s.registers[2], hex);
 	text += hex;
 
 	text += "\nX=";
-	u16ToHexStr(m_dcpu.getRegister(3), hex);
+	u16ToHexStr(s.registers[3], hex);
 	text += hex;
 
 	text += " Y=";
-	u16ToHexStr(m_dcpu.getRegister(4), hex);
+	u16ToHexStr(s.registers[4], hex);
 	text += hex;
 
 	text += " Z=";
-	u16ToHexStr(m_dcpu.getRegister(5), hex);
+	u16ToHexStr(s.registers[5], hex);
 	text += hex;
 
 	text += "\nI=";
-	u16ToHexStr(m_dcpu.getRegister(6), hex);
+	u16ToHexStr(s.registers[6], hex);
 	text += hex;
 
 	text += " J=";
-	u16ToHexStr(m_dcpu.getRegister(7), hex);
+	u16ToHexStr(s.registers[7], hex);
 	text += hex;
 
 	// Variables
 
 	text += "\nPC=";
-	u16ToHexStr(m_dcpu.getPC(), hex);
+	u16ToHexStr(s.pc, hex);
 	text += hex;
 
 	text += " SP=";
-	u16ToHexStr(m_dcpu.getSP(), hex);
+	u16ToHexStr(s.sp, hex);
 	text += hex;
 
 	text += " EX=";
-	u16ToHexStr(m_dcpu.getEX(), hex);
+	u16ToHexStr(s.ex, hex);
 	text += hex;
 
 	text += " IA=";
-	u16ToHexStr(m_dcpu.getIA(), hex);
+	u16ToHexStr(s.ia, hex);
 	text += hex;
 
 	// Cycles
 
 	text += "\nCycles=";
 	std::stringstream ss;
-	ss << m_dcpu.getCycles();
+	ss << s.cycles;
 	text += ss.str();
 
-	if(m_dcpu.getHaltCycles() > 0)
+	if(s.haltCycles > 0)
 		text += " on halt...";
 
-	// Draw stuff
+	// Distance to real time
+	ss.str("");
+	ss << "\nLag=" << s.lag << " Skipped=" << s.skippedCycles;
+	text += ss.str();
 
-	m_cpuStateText.setString(text);
-	m_cpuStateText.setPosition(10,10);
+	// Draw stuff
 
 	sf::RectangleShape rect(m_win.getView().getSize());
 	rect.setFillColor(sf::Color(0,0,0,192));
 	m_win.draw(rect);
-	m_win.draw(m_cpuStateText);
+
+	if(m_fontLoaded)
+	{
+		m_cpuStateText.setString(text);
+		m_cpuStateText.setPosition(10,10);
+		m_win.draw(m_cpuStateText);
+	}
+	else
+		drawOverlayText(text, 10, 10, 3);
+}
+
+void Emulator::drawOverlayText(const std::string & text, float x, float y, float scale)
+{
+	const float advanceX = scale * DCPU_LEM1802_TILE_W;
+	const float advanceY = scale * (DCPU_LEM1802_TILE_H + 2);
+
+	float cx = x;
+	float cy = y;
+
+	m_overlayGlyph.setScale(scale, scale);
+	m_overlayGlyph.setColor(sf::Color(255,255,255));
+
+	for(u32 i = 0; i < text.size(); ++i)
+	{
+		const u8 c = text[i];
+		if(c == '\n')
+		{
+			cx = x;
+			cy += advanceY;
+			continue;
+		}
+
+		const u8 k = c & 0x7f;
+		m_overlayGlyph.setTextureRect(sf::IntRect(
+			DCPU_LEM1802_TILE_W * (k % DCPU_LEM1802_CHARSET_W),
+			DCPU_LEM1802_TILE_H * (k / DCPU_LEM1802_CHARSET_W),
+			DCPU_LEM1802_TILE_W,
+			DCPU_LEM1802_TILE_H));
+		m_overlayGlyph.setPosition(cx, cy);
+		m_win.draw(m_overlayGlyph);
+
+		cx += advanceX;
+	}
 }
 
 
@@ -7,20 +7,60 @@
 #include "LEM1802.hpp"
 #include "Keyboard.hpp"
 #include "GenericClock.hpp"
+#include "FrameCapture.hpp"
+#include "DisplayStream.hpp"
+#include "TerminalRenderer.hpp"
+#include "LockFree.hpp"
+#include "Pacer.hpp"
+#include "KeyScript.hpp"
+
+// Max number of window events waiting for the emulation thread
+#define DCPU_EMU_INPUT_QUEUE_SIZE 64
+// Max number of cycles run at once to catch up with real time
+#define DCPU_EMU_MAX_BURST (DCPU_STANDARD_FREQUENCY / 10)
+// Longest sleep while the DCPU is idle, in milliseconds.
+// It is half a burst, so the cycles owed after it are never skipped.
+#define DCPU_EMU_MAX_IDLE_WAIT (1000 * DCPU_EMU_MAX_BURST / DCPU_STANDARD_FREQUENCY / 2)
+// Input is checked at least this often while sleeping, in milliseconds
+#define DCPU_EMU_IDLE_SLICE 10
 
 namespace dcpu
 {
 
 /*
-    SFML-based DCPU emulator window
+    SFML-based DCPU emulator window.
+    The DCPU and its devices run on their own thread. The window thread
+    only draws snapshots of the screen and sends input events back.
 */
 class Emulator
 {
 private :
 
+	// What the window thread needs to know about the emulation
+	struct Snapshot
+	{
+		bool screenMapped;
+		bool blinkVisible;
+		u8 border;
+		u16 vram[DCPU_LEM1802_VRAM_SIZE];
+		u16 palette[16];
+		u16 font[DCPU_LEM1802_FONT_SIZE];
+
+		// For the debug overlay
+		u16 registers[8];
+		u16 pc, sp, ex, ia;
+		u32 cycles;
+		u32 haltCycles;
+		s32 lag;
+		u32 skippedCycles;
+	};
+
 	sf::RenderWindow m_win;   // Main window
-	sf::Font m_font;            // Font for debug text
+	sf::Font m_font;            // Font for debug text (optional asset)
+	bool m_fontLoaded;          // If false, the embedded charset is used instead
 	sf::Text m_cpuStateText;  // CPU state display
+	sf::Texture m_overlayCharset; // Embedded bitmap font for debug text
+	sf::Sprite m_overlayGlyph;    // Sprite used to draw overlay characters
 
 	// RAMViz (Not implemented yet)
 	//sf::Image m_ramViz;         // RAM graphical view (words => pixels)
@@ -34,11 +74,33 @@ private :
 	Keyboard m_keyboard;
 	GenericClock m_clock;
 
+	FrameCapture m_capture; // Optional screen recording
+	DisplayStream m_stream; // Optional screen publishing
+	KeyScript m_keyScript;  // Optional scripted input
+
+	// Emulation thread
+	Pacer m_pacer;
+	sf::Thread m_cpuThread;
+	volatile bool m_cpuRunning;
+	volatile bool m_showCPUState; // The overlay needs fresh registers
+	TripleBuffer<Snapshot> m_snapshots;
+	SPSCQueue<sf::Event, DCPU_EMU_INPUT_QUEUE_SIZE> m_input;
+
+	// Copy of the screen owned by the window thread.
+	// The snapshots are replayed on a DCPU that never runs.
+	DCPU m_viewDcpu;
+	LEM1802 m_viewLem;
+
 public :
 
 	// Constructs an emulator with all memories of the CPU set to 0
-	Emulator()
+	Emulator() :
+		m_pacer(DCPU_STANDARD_FREQUENCY, DCPU_EMU_MAX_BURST),
+		m_cpuThread(&Emulator::runCPU, this)
 	{
+		m_fontLoaded = false;
+		m_cpuRunning = false;
+		m_showCPUState = false;
 //		m_win = 0;
 //		m_ramVizCursor = 0;
 	}
@@ -50,11 +112,23 @@ public :
 	}
 
 	// Loads ressources (images, fonts...).
+	// Default assets are compiled into the program, so this needs no file
+	// access unless assetsDir is given. Assets found in assetsDir
+	// override the embedded ones, missing ones are ignored.
 	// Returns false if it failed.
-	bool loadContent();
+	bool loadContent(const std::string & assetsDir = "");
 
-	// Loads a program into the DCPU16, returns false if it failed
-	bool loadProgram(const std::string & filename);
+	// Loads the assets of assetsDir that don't need a window
+	// (the LEM1802 charset), for headless runs. loadContent also does it.
+	// Returns false if it failed.
+	bool loadAssets(const std::string & assetsDir);
+
+	// Loads a program into the DCPU16, returns false if it failed.
+	// Included files are also searched in includePaths.
+	// Assembled programs are cached in cacheDir if it is not empty.
+	bool loadProgram(const std::string & filename,
+		const std::vector<std::string> & includePaths = std::vector<std::string>(),
+		const std::string & cacheDir = "");
 
 	// Dumps the DCPU memory as file(s), returns false if it failed
 	bool dumpMemory(const std::string & name);
@@ -62,14 +136,64 @@ public :
 	// Runs the emulator
 	void run();
 
+	// Runs the emulator without window nor input for the given
+	// number of DCPU cycles (or until the DCPU breaks)
+	void runHeadless(u32 cycles);
+
+	// Runs the emulator in the current terminal instead of a window,
+	// until Ctrl+C is pressed or the DCPU breaks.
+	// Returns false if the terminal can't be used.
+	bool runTerminal(TerminalRenderer::ColorMode colorMode);
+
+	// Records the LEM1802 screen every interval DCPU cycles while running.
+	// See FrameCapture::start(). Returns false if it failed.
+	bool startCapture(FrameCapture::Format format,
+		const std::string & filename, u32 interval);
+
+	// Publishes the LEM1802 screen on a local socket every interval
+	// DCPU cycles while running. See DisplayStream::start().
+	// Returns false if it failed.
+	bool startDisplayStream(const std::string & path, u32 interval);
+
+	// Types the keys of a script while running (see KeyScript).
+	// Returns false if it failed.
+	bool startKeyScript(const std::string & path);
+
 private :
 
+	// Emulation thread main loop
+	void runCPU();
+
+	// Emulation thread: sends the state of the emulation to the window
+	void publishSnapshot();
+
+	// Window thread: applies the last snapshot to the view screen
+	void applySnapshot(const Snapshot & s);
+	void mapViewLEM(u16 code, u16 b);
+
 	// Draws an overlay with information about the CPU
-	void drawCPUState();
+	void drawCPUState(const Snapshot & s);
 
-	// Updates the DCPU16
+	// Draws text with the embedded bitmap font, in window coordinates
+	void drawOverlayText(const std::string & text, float x, float y, float scale);
+
+	// Runs the DCPU16 for the cycles owed since the last update
 	void updateCPU();
 
+	// Returns how long the emulation can sleep because the DCPU has nothing
+	// to do until an interrupt (or zero if it is busy)
+	sf::Time getIdleTime() const;
+
+	// Emulation thread: sleeps until duration passed, input arrived
+	// or the CPU state overlay was toggled
+	void waitInput(sf::Time duration);
+
+	// Tells if the emulation could not keep up with real time
+	void printDrift();
+
+	void connectDevices();
+	void disconnectDevices();
+
 	//void updateRamViz();
 	//void drawRamViz();
 };
@@ -0,0 +1,312 @@
+#include <sstream>
+#include <iomanip>
+
+#include "FrameCapture.hpp"
+
+// Writer thread polling period when the queue is empty (SFML has no condition variable)
+#define DCPU_CAPTURE_POLL_MS 2
+
+namespace dcpu
+{
+FrameCapture::FrameCapture() :
+	m_thread(&FrameCapture::writeFrames, this)
+{
+	r_dcpu = 0;
+	r_lem = 0;
+	m_format = FORMAT_RAW;
+	m_interval = 0;
+	m_deduplicate = true;
+	m_frameCount = 0;
+	m_duplicateCount = 0;
+	m_droppedCount = 0;
+	m_lastHash = 0;
+	m_writing = false;
+}
+
+FrameCapture::~FrameCapture()
+{
+	stop();
+
+	for(u32 i = 0; i < m_freeFrames.size(); ++i)
+		delete m_freeFrames[i];
+}
+
+bool FrameCapture::parseFormat(const std::string & name, Format & format)
+{
+	if(name == "raw")
+		format = FORMAT_RAW;
+	else if(name == "y4m")
+		format = FORMAT_Y4M;
+	else if(name == "png")
+		format = FORMAT_PNG;
+	else
+		return false;
+	return true;
+}
+
+bool FrameCapture::start(DCPU & dcpu, LEM1802 & lem,
+	Format format, const std::string & filename, u32 interval)
+{
+	stop();
+
+	if(interval == 0)
+	{
+		std::cout << "E: FrameCapture: the interval must not be zero" << std::endl;
+		return false;
+	}
+
+	if(format != FORMAT_PNG)
+	{
+		m_ofs.open(filename.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+		if(!m_ofs.good())
+		{
+			std::cout << "E: FrameCapture: couldn't create file '"
+				<< filename << "'" << std::endl;
+			m_ofs.close();
+			return false;
+		}
+	}
+
+	if(format == FORMAT_Y4M)
+	{
+		// Frame rate is a ratio, DCPU frequency over interval
+		m_ofs << "YUV4MPEG2 W" << DCPU_LEM1802_W << " H" << DCPU_LEM1802_H
+			<< " F" << DCPU_STANDARD_FREQUENCY << ":" << interval
+			<< " Ip A1:1 C444\n";
+	}
+
+	r_dcpu = &dcpu;
+	r_lem = &lem;
+	m_format = format;
+	m_filename = filename;
+	m_interval = interval;
+	m_frameCount = 0;
+	m_duplicateCount = 0;
+	m_droppedCount = 0;
+	m_lastPixels.clear();
+	m_encoded.clear();
+
+	m_writing = true;
+	m_thread.launch();
+
+	// First frame right now
+	r_dcpu->getScheduler().schedule(this, r_dcpu->getCycles());
+
+	std::cout << "I: FrameCapture: started" << std::endl;
+	return true;
+}
+
+void FrameCapture::stop()
+{
+	if(r_dcpu == 0)
+		return;
+
+	r_dcpu->getScheduler().cancel(this);
+	r_dcpu = 0;
+	r_lem = 0;
+
+	// Let the writer empty the queue
+	{
+		sf::Lock lock(m_mutex);
+		m_writing = false;
+	}
+	m_thread.wait();
+
+	if(m_ofs.is_open())
+		m_ofs.close();
+
+	std::cout << "I: FrameCapture: stopped, "
+		<< m_frameCount << " frames, "
+		<< m_duplicateCount << " duplicates, "
+		<< m_droppedCount << " dropped" << std::endl;
+}
+
+void FrameCapture::onScheduledEvent(u16 id, u32 cycle)
+{
+	if(r_dcpu == 0)
+		return;
+
+	captureFrame();
+
+	r_dcpu->getScheduler().schedule(this, cycle + m_interval);
+}
+
+u32 FrameCapture::hashPixels(const u32 * pixels, u32 count)
+{
+	u32 h = 2166136261u;
+	for(u32 i = 0; i < count; ++i)
+	{
+		h = ((h ^ (pixels[i] & 0xffffffff)) * 16777619u) & 0xffffffff;
+	}
+	return h;
+}
+
+void FrameCapture::captureFrame()
+{
+	const u32 number = m_frameCount++;
+	const u32 count = DCPU_LEM1802_W * DCPU_LEM1802_H;
+
+	r_lem->renderPixels();
+	const u32 * pixels = r_lem->getPixels();
+
+	bool repeat = false;
+	if(m_deduplicate)
+	{
+		// Pixels are compared only if hashes match
+		const u32 h = hashPixels(pixels, count);
+		if(h == m_lastHash && !m_lastPixels.empty()
+		&& memcmp(&m_lastPixels[0], pixels, count * sizeof(u32)) == 0)
+		{
+			++m_duplicateCount;
+
+			// Streams must keep one frame per interval
+			if(m_format == FORMAT_PNG)
+				return;
+			repeat = true;
+		}
+		else
+		{
+			m_lastHash = h;
+			m_lastPixels.assign(pixels, pixels + count);
+		}
+	}
+
+	Frame * frame = 0;
+	{
+		sf::Lock lock(m_mutex);
+
+		if(m_queue.size() >= DCPU_CAPTURE_QUEUE_SIZE)
+		{
+			// Never wait for the writer
+			++m_droppedCount;
+			// The next frame must not be taken as a duplicate of this one
+			m_lastPixels.clear();
+			return;
+		}
+
+		if(!m_freeFrames.empty())
+		{
+			frame = m_freeFrames.back();
+			m_freeFrames.pop_back();
+		}
+	}
+
+	if(frame == 0)
+		frame = new Frame();
+
+	frame->number = number;
+	frame->repeat = repeat;
+	if(!repeat)
+		frame->pixels.assign(pixels, pixels + count);
+
+	sf::Lock lock(m_mutex);
+	m_queue.push_back(frame);
+}
+
+void FrameCapture::writeFrames()
+{
+	while(true)
+	{
+		Frame * frame = 0;
+		{
+			sf::Lock lock(m_mutex);
+			if(!m_queue.empty())
+			{
+				frame = m_queue.front();
+				m_queue.pop_front();
+			}
+			else if(!m_writing)
+				break;
+		}
+
+		if(frame == 0)
+		{
+			sf::sleep(sf::milliseconds(DCPU_CAPTURE_POLL_MS));
+			continue;
+		}
+
+		writeFrame(*frame);
+
+		sf::Lock lock(m_mutex);
+		m_freeFrames.push_back(frame);
+	}
+}
+
+void FrameCapture::writeFrame(const Frame & frame)
+{
+	const u32 * pixels = &frame.pixels[0];
+
+	switch(m_format)
+	{
+	case FORMAT_RAW:
+	case FORMAT_Y4M:
+		// A repeated frame is written again as it was encoded.
+		// Repeats always follow a queued frame (drops reset m_lastPixels).
+		if(!frame.repeat)
+			encodeFrame(frame);
+		if(m_format == FORMAT_Y4M)
+			m_ofs << "FRAME\n";
+		m_ofs.write((const char*)&m_encoded[0], m_encoded.size());
+		break;
+
+	case FORMAT_PNG:
+	{
+		sf::Image img;
+		img.create(DCPU_LEM1802_W, DCPU_LEM1802_H);
+		for(u32 y = 0; y < DCPU_LEM1802_H; ++y)
+		for(u32 x = 0; x < DCPU_LEM1802_W; ++x)
+		{
+			const u32 p = pixels[y * DCPU_LEM1802_W + x];
+			img.setPixel(x, y, sf::Color(p & 0xff, (p >> 8) & 0xff, (p >> 16) & 0xff));
+		}
+
+		std::stringstream ss;
+		ss << m_filename << "_" << std::setw(6) << std::setfill('0') << frame.number << ".png";
+		if(!img.saveToFile(ss.str()))
+			std::cout << "E: FrameCapture: couldn't save '" << ss.str() << "'" << std::endl;
+	}
+		break;
+
+	default:
+		break;
+	}
+}
+
+void FrameCapture::encodeFrame(const Frame & frame)
+{
+	const u32 count = DCPU_LEM1802_W * DCPU_LEM1802_H;
+	const u32 * pixels = &frame.pixels[0];
+
+	if(m_format == FORMAT_RAW)
+	{
+		m_encoded.resize(count * 4);
+		for(u32 i = 0; i < count; ++i)
+		{
+			const u32 p = pixels[i];
+			m_encoded[4*i]   = p & 0xff;
+			m_encoded[4*i+1] = (p >> 8) & 0xff;
+			m_encoded[4*i+2] = (p >> 16) & 0xff;
+			m_encoded[4*i+3] = (p >> 24) & 0xff;
+		}
+	}
+	else
+	{
+		// BT.601, studio range, no chroma subsampling
+		m_encoded.resize(count * 3);
+		u8 * py = &m_encoded[0];
+		u8 * pu = py + count;
+		u8 * pv = pu + count;
+		for(u32 i = 0; i < count; ++i)
+		{
+			const s32 r = pixels[i] & 0xff;
+			const s32 g = (pixels[i] >> 8) & 0xff;
+			const s32 b = (pixels[i] >> 16) & 0xff;
+			py[i] = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+			pu[i] = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+			pv[i] = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+		}
+	}
+}
+
+} // namespace dcpu
+
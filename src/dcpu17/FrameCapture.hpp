@@ -0,0 +1,117 @@
+#ifndef HEADER_DCPU_FRAMECAPTURE_HPP_INCLUDED
+#define HEADER_DCPU_FRAMECAPTURE_HPP_INCLUDED
+
+#include <deque>
+#include <fstream>
+#include <vector>
+#include <SFML/System.hpp>
+
+#include "LEM1802.hpp"
+
+// Max number of frames waiting to be written
+#define DCPU_CAPTURE_QUEUE_SIZE 64
+
+namespace dcpu
+{
+/*
+	Records LEM1802 frames at a fixed interval of DCPU cycles.
+	Frames are taken by the DCPU scheduler, then encoded and written
+	by a background thread, so the emulation never waits for the disk.
+	If the writer can't keep up, frames are dropped and counted.
+*/
+class FrameCapture : public IScheduled
+{
+public :
+
+	enum Format
+	{
+		FORMAT_RAW = 0, // RGBA frames, one after the other
+		FORMAT_Y4M,     // YUV4MPEG2 stream (4:4:4)
+		FORMAT_PNG      // One PNG file per frame
+	};
+
+	FrameCapture();
+	~FrameCapture();
+
+	// Starts capturing the screen of lem every interval DCPU cycles.
+	// For FORMAT_PNG, filename is a prefix: frames are saved as
+	// <filename>_<frame number>.png.
+	// Returns false if an error occurred.
+	bool start(DCPU & dcpu, LEM1802 & lem,
+		Format format, const std::string & filename, u32 interval);
+
+	// Stops capturing, and waits for queued frames to be written
+	void stop();
+
+	bool isRunning() const { return r_dcpu != 0; }
+
+	// If enabled (default), a frame identical to the previous one is not
+	// encoded again. PNG sequences skip it (frame numbers keep counting,
+	// so they show where frames were skipped). Raw and Y4M streams have no
+	// frame numbers: the previous encoded frame is written again, so frame
+	// N is still taken at cycle N * interval.
+	void setDeduplicate(bool d) { m_deduplicate = d; }
+
+	// Statistics
+	u32 getFrameCount() const { return m_frameCount; }
+	u32 getDuplicateCount() const { return m_duplicateCount; }
+	u32 getDroppedCount() const { return m_droppedCount; }
+
+	// Gets a format from its name ("raw", "y4m" or "png").
+	// Returns false if the name is unknown.
+	static bool parseFormat(const std::string & name, Format & format);
+
+	virtual void onScheduledEvent(u16 id, u32 cycle);
+
+private :
+
+	struct Frame
+	{
+		std::vector<u32> pixels;
+		u32 number;
+		bool repeat; // Same as the previous frame (pixels are not set)
+	};
+
+	// Takes a frame from the LEM1802 (emulation thread)
+	void captureFrame();
+
+	// Writer thread loop
+	void writeFrames();
+
+	// Encodes and writes one frame (writer thread)
+	void writeFrame(const Frame & frame);
+
+	// Encodes a frame of a stream into m_encoded (writer thread)
+	void encodeFrame(const Frame & frame);
+
+	// Hashes pixels (FNV-1a)
+	static u32 hashPixels(const u32 * pixels, u32 count);
+
+	DCPU * r_dcpu;
+	LEM1802 * r_lem;
+	Format m_format;
+	std::string m_filename;
+	std::ofstream m_ofs;
+	u32 m_interval;
+	bool m_deduplicate;
+
+	u32 m_frameCount;
+	u32 m_duplicateCount;
+	u32 m_droppedCount;
+	u32 m_lastHash;
+	std::vector<u32> m_lastPixels;
+	std::vector<u8> m_encoded; // Last frame of a stream (writer thread)
+
+	// Shared with the writer thread (protected by m_mutex)
+	sf::Mutex m_mutex;
+	std::deque<Frame*> m_queue;
+	std::vector<Frame*> m_freeFrames;
+	bool m_writing;
+
+	sf::Thread m_thread;
+
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_FRAMECAPTURE_HPP_INCLUDED
@@ -4,7 +4,7 @@
 
 namespace dcpu
 {
-void GenericClock::interrupt()
+void GenericClock::interrupt(RegisterFile & r)
 {
 #ifdef DCPU_DEBUG
 	assert(r_dcpu != 0);
@@ -13,23 +13,28 @@ void GenericClock::interrupt()
 		return;
 #endif
 
-	u16 a = r_dcpu->getRegister(AD_A);
+	u16 a = r[AD_A];
 	switch(a)
 	{
 	case 0:
-	{
-		const u16 b = r_dcpu->getRegister(AD_B);
-		m_tickInterval = 60.f / (float)b;
+		// (Re)starts the clock from the current cycle
+		m_rate = r[AD_B];
+		m_syncCycle = r_dcpu->getCycles();
+		m_phase = 0;
 		m_ticks = 0;
-	}
+		m_pendingTicks = 0;
+		scheduleNext();
 		break;
 
 	case 1:
-		r_dcpu->setRegister(AD_C, m_ticks);
+		r[AD_C] = getTicks();
 		break;
 
 	case 2:
-		m_interruptMsg = r_dcpu->getRegister(AD_B);
+		sync(r_dcpu->getCycles());
+		m_interruptMsg = r[AD_B];
+		m_pendingTicks = 0;
+		scheduleNext();
 		break;
 
 	default:
@@ -42,27 +47,89 @@ void GenericClock::interrupt()
 	}
 }
 
-void GenericClock::update(float delta)
+u16 GenericClock::getTicks()
 {
-#ifdef DCPU_DEBUG
-	assert(r_dcpu != 0);
-#else
-	if(r_dcpu == 0)
+	if(r_dcpu != 0)
+		sync(r_dcpu->getCycles());
+	return m_ticks;
+}
+
+u32 GenericClock::sync(u32 now)
+{
+	if(m_rate == 0)
+		return 0;
+
+	// Tick n after the sync point is due at
+	// m_syncCycle + (m_phase + n * period) / 60, with period the
+	// number of cycles for 60 ticks. It is counted if that is <= now.
+	const sf::Uint64 period = static_cast<sf::Uint64>(DCPU_STANDARD_FREQUENCY) * m_rate;
+	const sf::Uint64 elapsed = (now - m_syncCycle) & 0xffffffff;
+	const sf::Uint64 n = (elapsed * DCPU_GENERIC_CLOCK_TICKS_PER_SECOND
+		+ DCPU_GENERIC_CLOCK_TICKS_PER_SECOND - 1 - m_phase) / period;
+	if(n == 0)
+		return 0;
+
+	// Moves the sync point to the last tick, keeping the fraction
+	const sf::Uint64 t = m_phase + n * period;
+	m_syncCycle += static_cast<u32>(t / DCPU_GENERIC_CLOCK_TICKS_PER_SECOND);
+	m_phase = static_cast<u32>(t % DCPU_GENERIC_CLOCK_TICKS_PER_SECOND);
+	m_ticks += static_cast<u16>(n);
+
+	return static_cast<u32>(n);
+}
+
+void GenericClock::scheduleNext()
+{
+	cancelWakeUp(EVENT_TICK);
+	cancelWakeUp(EVENT_SYNC);
+
+	if(m_rate == 0)
 		return;
-#endif
 
-	if(m_timer.getElapsedTime().asSeconds() >= m_tickInterval)
+	// Late interrupts are sent one per step
+	if(m_pendingTicks != 0)
+	{
+		wakeUpIn(1, EVENT_TICK);
+		return;
+	}
+
+	// Without interrupts, ticks are only counted when the DCPU asks
+	if(m_interruptMsg == 0)
 	{
-		m_timer.restart();
-		m_ticks++;
-		if(m_interruptMsg)
-			r_dcpu->interrupt(m_interruptMsg);
+		wakeUpIn(DCPU_GENERIC_CLOCK_SYNC_CYCLES, EVENT_SYNC);
+		return;
 	}
+
+	const sf::Uint64 period = static_cast<sf::Uint64>(DCPU_STANDARD_FREQUENCY) * m_rate;
+	const u32 next = static_cast<u32>((m_phase + period) / DCPU_GENERIC_CLOCK_TICKS_PER_SECOND);
+	wakeUpAt(m_syncCycle + next, EVENT_TICK);
 }
 
-} // namespace dcpu
+void GenericClock::onScheduledEvent(u16 id, u32 cycle)
+{
+	if(r_dcpu == 0)
+		return;
 
+	u32 n = sync(r_dcpu->getCycles());
 
+	if(id == EVENT_TICK && m_interruptMsg != 0)
+	{
+		if(n > 1 && m_catchUp != CATCHUP_ALL)
+		{
+			if(m_catchUp == CATCHUP_SKIP)
+				m_ticks -= static_cast<u16>(n - 1);
+			n = 1;
+		}
+		m_pendingTicks += n;
 
+		if(m_pendingTicks != 0)
+		{
+			--m_pendingTicks;
+			sendInterrupt(m_interruptMsg);
+		}
+	}
 
+	scheduleNext();
+}
 
+} // namespace dcpu
@@ -8,12 +8,39 @@
 #define DCPU_GENERIC_CLOCK_VERSION 1
 #define DCPU_GENERIC_CLOCK_HID 0x12d0b402
 
+// The clock ticks 60/B times per second:
+// a tick lasts DCPU_STANDARD_FREQUENCY * B / 60 cycles.
+#define DCPU_GENERIC_CLOCK_TICKS_PER_SECOND 60
+
+// When no interrupt is scheduled, the tick count is brought up to date
+// at least this often, so cycle differences never wrap around.
+#define DCPU_GENERIC_CLOCK_SYNC_CYCLES 0x40000000
+
 namespace dcpu
 {
+/*
+	Generic clock, driven by DCPU cycles: ticks happen at exact cycle
+	deadlines whatever the host does (slow frames, fast-forward...).
+
+	Tick deadlines are computed with integer math from the last
+	synchronization point, so no rounding error accumulates
+	(1666.67 cycles per tick at 60Hz gives exactly 100000 cycles per second).
+	The tick count is derived from the cycle count when the DCPU asks for it,
+	so the clock only schedules tick events when an interrupt message is set.
+*/
 class GenericClock : public HardwareDevice
 {
 public :
 
+	// What to do when several ticks are due at once
+	// (the event ran late, because the DCPU was busy)
+	enum CatchUp
+	{
+		CATCHUP_ALL = 0, // One interrupt per tick, late ones are sent in a row
+		CATCHUP_ONCE,    // One interrupt for all due ticks, they are still counted
+		CATCHUP_SKIP     // One interrupt, late ticks are neither sent nor counted
+	};
+
 	GenericClock() : HardwareDevice()
 	{
 		m_name = "GenericClock";
@@ -21,25 +48,51 @@ public :
 		m_manufacturerID = DCPU_GENERIC_CLOCK_MANUFACTURER_ID;
 		m_version = DCPU_GENERIC_CLOCK_VERSION;
 
-		m_tickInterval = 0;
+		m_rate = 0;
+		m_syncCycle = 0;
+		m_phase = 0;
 		m_ticks = 0;
+		m_pendingTicks = 0;
 		m_interruptMsg = 0;
+		m_catchUp = CATCHUP_ALL;
+		// Merged ticks are still counted (see interrupt code 1)
+		setCoalescing(true);
 	}
 
-	virtual void interrupt();
-	virtual void update(float delta);
+	virtual void interrupt(RegisterFile & r);
+	virtual void onScheduledEvent(u16 id, u32 cycle);
+
+	void setCatchUp(CatchUp catchUp) { m_catchUp = catchUp; }
+	CatchUp getCatchUp() const { return m_catchUp; }
+
+	// Ticks since the clock was last started, at the current cycle
+	u16 getTicks();
 
 protected :
 
-	sf::Clock m_timer;
-	float m_tickInterval;
+	enum EventID
+	{
+		EVENT_TICK = 0,
+		EVENT_SYNC
+	};
+
+	// Counts the ticks that happened up to cycle now.
+	// Returns how many were added.
+	u32 sync(u32 now);
+
+	// Schedules the next tick interrupt, or a sync if there is none
+	void scheduleNext();
+
+	u16 m_rate;           // B: 60/B ticks per second, 0 if stopped
+	u32 m_syncCycle;      // Cycle of the last counted tick (or of the start)
+	u32 m_phase;          // Sub-cycle part of m_syncCycle, in 1/60 cycles
 	u16 m_ticks;
+	u32 m_pendingTicks;   // Tick interrupts not sent yet (CATCHUP_ALL)
 	u16 m_interruptMsg;
+	CatchUp m_catchUp;
 
 };
 
 } // namespace dcpu
 
 #endif // HEADER_CLOCK_HPP_INCLUDED
-
-
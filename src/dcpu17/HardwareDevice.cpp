@@ -17,6 +17,13 @@ void HardwareDevice::connect(DCPU & dcpu)
 void HardwareDevice::disconnect()
 {
 	assert(r_dcpu != 0);
+	if(m_coalescedInterrupts != 0)
+	{
+		std::cout << "I: " << m_name << ": " << m_coalescedInterrupts
+			<< " interrupts coalesced" << std::endl;
+	}
+	r_dcpu->getScheduler().cancel(this);
+	r_dcpu->getBus().unmap(this);
 	r_dcpu->disconnectHardware(this);
 	r_dcpu = 0;
 #ifdef DCPU_DEBUG
@@ -24,5 +31,16 @@ void HardwareDevice::disconnect()
 #endif
 }
 
+bool HardwareDevice::sendInterrupt(u16 msg)
+{
+	if(m_coalescing && r_dcpu->isInterruptQueued(msg))
+	{
+		++m_coalescedInterrupts;
+		return false;
+	}
+	r_dcpu->interrupt(msg);
+	return true;
+}
+
 } // namespace dcpu
 
@@ -5,7 +5,12 @@
 
 namespace dcpu
 {
-class HardwareDevice : IHardwareDevice
+/*
+	Base of DCPU devices. A device does nothing by itself: it reacts to
+	HWI, to its own wake-ups on the DCPU scheduler, and to stores in the
+	RAM ranges it observes. Nothing calls it when it has nothing to do.
+*/
+class HardwareDevice : IHardwareDevice, public IScheduled, public IMemoryObserver
 {
 public :
 
@@ -16,6 +21,8 @@ public :
 		m_manufacturerID = 0;
 		m_version = 0;
 		m_name = "<AbstractHardwareDevice>";
+		m_coalescing = false;
+		m_coalescedInterrupts = 0;
 	}
 
 	virtual u32 getHID() const              { return m_HID; }
@@ -25,15 +32,52 @@ public :
 	virtual void connect(DCPU & dcpu);
 	virtual void disconnect();
 
-	virtual void update(float delta) {}
+	// Called when a wake-up is due (see wakeUpAt())
+	virtual void onScheduledEvent(u16 id, u32 cycle) {}
+
+	// Called when the DCPU stores to an observed range (see observe())
+	virtual void onMemoryWrite(u16 addr, u16 value) {}
+
+	// If enabled, an interrupt is not queued if the DCPU already has one
+	// with the same message waiting: both are handled at once.
+	// Only for devices whose interrupts mean "something happened",
+	// and where the program can find out how many times.
+	void setCoalescing(bool enable) { m_coalescing = enable; }
+	bool isCoalescing() const { return m_coalescing; }
+
+	// Number of interrupts merged with a queued one
+	u32 getCoalescedInterrupts() const { return m_coalescedInterrupts; }
 
 protected :
 
+	// Sends an interrupt to the DCPU, unless it is merged with
+	// a queued one. Returns false if it was merged.
+	bool sendInterrupt(u16 msg);
+
+	// Asks for onScheduledEvent(id, cycle) at the given DCPU cycle
+	void wakeUpAt(u32 cycle, u16 id = 0) { r_dcpu->getScheduler().schedule(this, cycle, id); }
+
+	// Asks for onScheduledEvent(id, cycle) in the given number of cycles
+	void wakeUpIn(u32 cycles, u16 id = 0) { wakeUpAt(r_dcpu->getCycles() + cycles, id); }
+
+	// Cancels the wake-ups with the given id
+	void cancelWakeUp(u16 id) { r_dcpu->getScheduler().cancel(this, id); }
+
+	bool isWakeUpPending(u16 id) const { return r_dcpu->getScheduler().isScheduled(this, id); }
+
+	// Calls onMemoryWrite() for the DCPU stores in [first, first + size[
+	void observe(u16 first, u32 size) { r_dcpu->getBus().map(this, first, size); }
+
+	// Stops observing all ranges
+	void unobserveAll() { r_dcpu->getBus().unmap(this); }
+
 	DCPU * r_dcpu;
 	u32 m_HID;
 	u32 m_manufacturerID;
 	u16 m_version;
 	std::string m_name;
+	bool m_coalescing;
+	u32 m_coalescedInterrupts;
 
 };
 
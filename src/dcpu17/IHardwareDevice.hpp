@@ -14,7 +14,9 @@ public :
 	virtual u32 getHID() const = 0;
 	virtual u16 getVersion() const = 0;
 	virtual u32 getManufacturerID() const = 0;
-	virtual void interrupt() = 0;
+
+	// Handles HWI. Registers are read and written directly in r.
+	virtual void interrupt(RegisterFile & r) = 0;
 };
 
 } // namespace dcpu
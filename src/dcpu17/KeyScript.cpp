@@ -0,0 +1,381 @@
+#include <cstdlib>
+#include <iostream>
+
+#ifndef WINDOWS
+	#include <errno.h>
+	#include <poll.h>
+	#include <unistd.h>
+#endif
+
+#include "KeyScript.hpp"
+
+namespace dcpu
+{
+
+KeyScript::KeyScript()
+{
+	r_dcpu = 0;
+	r_keyboard = 0;
+	r_input = 0;
+	m_polled = false;
+	m_inputEnded = false;
+	m_lineNumber = 0;
+	m_startCycle = 0;
+	m_entryCycle = 0;
+	m_spacing = 0;
+	m_nextKey = 0;
+	m_typedKeys = 0;
+	m_waitCount = 0;
+}
+
+KeyScript::~KeyScript()
+{
+	stop();
+}
+
+bool KeyScript::start(DCPU & dcpu, Keyboard & keyboard, const std::string & path)
+{
+	stop();
+
+	if(path == "-")
+	{
+#ifdef WINDOWS
+		r_input = &std::cin;
+#else
+		// Reading a pipe would block the emulation until its writer writes
+		m_polled = true;
+#endif
+	}
+	else
+	{
+		m_file.open(path.c_str());
+		if(!m_file.good())
+		{
+			std::cout << "E: KeyScript: couldn't open '" << path << "'" << std::endl;
+			m_file.close();
+			return false;
+		}
+		r_input = &m_file;
+	}
+
+	r_dcpu = &dcpu;
+	r_keyboard = &keyboard;
+	m_path = path;
+	m_received.clear();
+	m_inputEnded = false;
+	m_lineNumber = 0;
+	m_startCycle = dcpu.getCycles();
+	m_entryCycle = m_startCycle;
+	m_spacing = 0;
+	m_keys.clear();
+	m_nextKey = 0;
+	m_typedKeys = 0;
+	m_waitCount = 0;
+
+	if(!readNextEntry())
+	{
+		// An empty script is not an error
+		const bool empty = m_inputEnded;
+		finish();
+		return empty;
+	}
+
+	return true;
+}
+
+void KeyScript::stop()
+{
+	if(r_dcpu == 0)
+		return;
+
+	r_dcpu->getScheduler().cancel(this);
+	finish();
+}
+
+void KeyScript::finish()
+{
+	std::cout << "I: KeyScript: " << m_typedKeys << " keys typed";
+	if(m_waitCount != 0)
+		std::cout << ", waited " << m_waitCount << " times for the keyboard";
+	std::cout << std::endl;
+
+	if(m_file.is_open())
+		m_file.close();
+	r_input = 0;
+	m_polled = false;
+	m_received.clear();
+	r_dcpu = 0;
+	r_keyboard = 0;
+}
+
+void KeyScript::onScheduledEvent(u16 id, u32 cycle)
+{
+	if(r_dcpu == 0)
+		return;
+
+	while(m_nextKey < m_keys.size())
+	{
+		// Backpressure: the program will read keys at some point
+		if(r_keyboard->isBufferFull())
+		{
+			++m_waitCount;
+			r_dcpu->getScheduler().schedule(this, cycle + DCPU_KEY_SCRIPT_RETRY_CYCLES);
+			return;
+		}
+
+		r_keyboard->typeKey(m_keys[m_nextKey]);
+		++m_nextKey;
+		++m_typedKeys;
+
+		if(m_spacing != 0 && m_nextKey < m_keys.size())
+		{
+			r_dcpu->getScheduler().schedule(this, cycle + m_spacing);
+			return;
+		}
+	}
+
+	if(!readNextEntry())
+		finish();
+}
+
+bool KeyScript::readNextEntry()
+{
+	std::string line;
+	std::vector<std::string> tokens;
+
+	while(true)
+	{
+		const LineStatus status = readLine(line);
+		if(status == KS_END)
+			break;
+		if(status == KS_PENDING)
+		{
+			r_dcpu->getScheduler().schedule(this, r_dcpu->getCycles() + DCPU_KEY_SCRIPT_POLL_CYCLES);
+			return true;
+		}
+
+		++m_lineNumber;
+
+		if(!tokenize(line, tokens))
+		{
+			std::cout << "E: KeyScript: " << m_path << ":" << m_lineNumber
+				<< ": unterminated text" << std::endl;
+			return false;
+		}
+
+		if(tokens.empty() || tokens[0][0] == '#')
+			continue;
+
+		if(tokens[0] == "buffer" || tokens[0] == "spacing")
+		{
+			char * end = 0;
+			const u32 n = tokens.size() == 2 ? std::strtoul(tokens[1].c_str(), &end, 0) : 0;
+			if(end == 0 || *end != '\0')
+			{
+				std::cout << "E: KeyScript: " << m_path << ":" << m_lineNumber
+					<< ": expected " << tokens[0] << " <number>" << std::endl;
+				return false;
+			}
+
+			if(tokens[0] == "buffer")
+				r_keyboard->setBufferSize(n < 0xffff ? n : 0xffff);
+			else
+				m_spacing = n;
+			continue;
+		}
+
+		// Time of the entry
+		const bool relative = tokens[0][0] == '+';
+		char * end = 0;
+		const u32 t = std::strtoul(tokens[0].c_str() + (relative ? 1 : 0), &end, 0);
+		if(*end != '\0' || tokens.size() < 2)
+		{
+			std::cout << "E: KeyScript: " << m_path << ":" << m_lineNumber
+				<< ": expected <time> <keys>" << std::endl;
+			return false;
+		}
+
+		m_keys.clear();
+		m_nextKey = 0;
+		for(u32 i = 1; i < tokens.size(); ++i)
+		{
+			if(!parseKeys(tokens[i], m_keys))
+			{
+				std::cout << "E: KeyScript: " << m_path << ":" << m_lineNumber
+					<< ": unknown key '" << tokens[i] << "'" << std::endl;
+				return false;
+			}
+		}
+
+		m_entryCycle = relative ? m_entryCycle + t : m_startCycle + t;
+
+		// A line received late is typed now, then keys follow
+		// from there (not from the cycle the entry was due)
+		const u32 now = r_dcpu->getCycles();
+		r_dcpu->getScheduler().schedule(this, isCycleAfter(m_entryCycle, now) ? m_entryCycle : now);
+		return true;
+	}
+
+	// End of the script
+	return false;
+}
+
+KeyScript::LineStatus KeyScript::readLine(std::string & line)
+{
+	if(!m_polled)
+	{
+		if(std::getline(*r_input, line))
+			return KS_LINE;
+		m_inputEnded = true;
+		return KS_END;
+	}
+
+#ifndef WINDOWS
+	while(true)
+	{
+		const std::string::size_type end = m_received.find('\n');
+		if(end != std::string::npos)
+		{
+			line.assign(m_received, 0, end);
+			m_received.erase(0, end + 1);
+			return KS_LINE;
+		}
+
+		if(m_inputEnded)
+		{
+			// The last line may have no line ending
+			if(m_received.empty())
+				return KS_END;
+			line.swap(m_received);
+			m_received.clear();
+			return KS_LINE;
+		}
+
+		pollfd fd;
+		fd.fd = STDIN_FILENO;
+		fd.events = POLLIN;
+		fd.revents = 0;
+		if(poll(&fd, 1, 0) <= 0)
+			return KS_PENDING;
+
+		// Doesn't block, poll() said there is something to read
+		char buffer[256];
+		const ssize_t count = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+		if(count > 0)
+			m_received.append(buffer, count);
+		else if(count == 0 || (errno != EINTR && errno != EAGAIN))
+			m_inputEnded = true;
+	}
+#else
+	return KS_END;
+#endif
+}
+
+bool KeyScript::tokenize(const std::string & line, std::vector<std::string> & tokens)
+{
+	tokens.clear();
+
+	u32 i = 0;
+	while(i < line.size())
+	{
+		const char c = line[i];
+		if(c == ' ' || c == '\t' || c == '\r')
+		{
+			++i;
+			continue;
+		}
+
+		std::string token;
+		if(c == '"')
+		{
+			// Quotes are kept so parseKeys() knows it is text
+			token += c;
+			++i;
+			while(i < line.size() && line[i] != '"')
+			{
+				if(line[i] == '\\' && i + 1 < line.size())
+				{
+					token += line[i];
+					++i;
+				}
+				token += line[i];
+				++i;
+			}
+			if(i == line.size())
+				return false;
+			token += '"';
+			++i;
+		}
+		else
+		{
+			while(i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+			{
+				token += line[i];
+				++i;
+			}
+		}
+
+		tokens.push_back(token);
+	}
+
+	return true;
+}
+
+bool KeyScript::parseKeys(const std::string & token, std::vector<u16> & keys)
+{
+	if(token.empty())
+		return false;
+
+	if(token[0] == '"')
+	{
+		for(u32 i = 1; i + 1 < token.size(); ++i)
+		{
+			char c = token[i];
+			if(c == '\\')
+			{
+				c = token[++i];
+				if(c == 'n')
+				{
+					keys.push_back(KB_RETURN);
+					continue;
+				}
+			}
+			if(c < KB_ASCII_BEG || c >= KB_ASCII_END)
+				return false;
+			keys.push_back(c);
+		}
+		return true;
+	}
+
+	if(token[0] >= '0' && token[0] <= '9')
+	{
+		char * end = 0;
+		const u32 k = std::strtoul(token.c_str(), &end, 0);
+		if(*end != '\0' || k > 0xffff)
+			return false;
+		keys.push_back(k);
+		return true;
+	}
+
+	static const char * names[] = {
+		"BACKSPACE", "RETURN", "INSERT", "DELETE", "UP", "DOWN",
+		"LEFT", "RIGHT", "SHIFT", "CONTROL", "SPACE"
+	};
+	static const u16 codes[] = {
+		KB_BACKSPACE, KB_RETURN, KB_INSERT, KB_DELETE, KB_UP, KB_DOWN,
+		KB_LEFT, KB_RIGHT, KB_SHIFT, KB_CONTROL, ' '
+	};
+
+	for(u32 i = 0; i < sizeof(codes) / sizeof(u16); ++i)
+	{
+		if(token == names[i])
+		{
+			keys.push_back(codes[i]);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+} // namespace dcpu
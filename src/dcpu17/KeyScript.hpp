@@ -0,0 +1,113 @@
+#ifndef HEADER_DCPU_KEYSCRIPT_HPP_INCLUDED
+#define HEADER_DCPU_KEYSCRIPT_HPP_INCLUDED
+
+#include <fstream>
+#include <vector>
+
+#include "Keyboard.hpp"
+
+// Cycles to wait before trying again when the keyboard buffer is full
+#define DCPU_KEY_SCRIPT_RETRY_CYCLES 100
+// Cycles to wait before polling the standard input again for the next line
+#define DCPU_KEY_SCRIPT_POLL_CYCLES 1000
+
+namespace dcpu
+{
+
+/*
+	Types keys on a Keyboard at given DCPU cycles, read from a text script
+	(file or pipe). Keys are delivered by the DCPU scheduler, so a run
+	types the same keys at the same cycles whatever the host does.
+
+	Script syntax, one entry per line:
+
+	# comment
+	<time> <key> [<key>...]
+	buffer <size>      sets the keyboard buffer size
+	spacing <cycles>   cycles between keys of the same entry (default 0)
+
+	time is a DCPU cycle counted from the start of the script, or +n for
+	n cycles after the previous entry. A key is "text" (one key per
+	character, with \n for return, \" and \\), a key name (RETURN,
+	BACKSPACE, INSERT, DELETE, UP, DOWN, LEFT, RIGHT, SHIFT, CONTROL,
+	SPACE) or a key code (0x41 or 65).
+
+	Lines are only read when the previous entry is typed, so a pipe
+	can feed a running emulator. The standard input is polled without
+	blocking: while the next line doesn't come, the emulation goes on,
+	and an entry that became due meanwhile is typed as soon as it comes.
+	If the keyboard buffer is full, the script waits for the program
+	to read keys instead of dropping them.
+*/
+class KeyScript : public IScheduled
+{
+public :
+
+	KeyScript();
+	~KeyScript();
+
+	// Starts typing the script at path ("-" reads the standard input).
+	// Returns false if an error occurred.
+	bool start(DCPU & dcpu, Keyboard & keyboard, const std::string & path);
+
+	// Stops typing (keys already typed stay in the keyboard)
+	void stop();
+
+	bool isRunning() const { return r_dcpu != 0; }
+
+	// Number of keys typed since start
+	u32 getTypedKeys() const { return m_typedKeys; }
+
+	// Number of times the script had to wait for a full keyboard buffer
+	u32 getWaitCount() const { return m_waitCount; }
+
+	virtual void onScheduledEvent(u16 id, u32 cycle);
+
+	// Appends the keys described by one script token.
+	// Returns false if the token is not a key.
+	static bool parseKeys(const std::string & token, std::vector<u16> & keys);
+
+private :
+
+	enum LineStatus
+	{
+		KS_LINE = 0,
+		KS_PENDING, // Not received yet
+		KS_END
+	};
+
+	// Reads the script until the next timed entry and schedules it
+	// (or schedules polling again if the next line is not there yet).
+	// Returns false at the end of the script or on error.
+	bool readNextEntry();
+
+	// Gets the next line of the script
+	LineStatus readLine(std::string & line);
+
+	// Splits a line into tokens ("quoted text" is one token)
+	bool tokenize(const std::string & line, std::vector<std::string> & tokens);
+
+	// Stops at the end of the script
+	void finish();
+
+	DCPU * r_dcpu;
+	Keyboard * r_keyboard;
+	std::ifstream m_file;
+	std::istream * r_input;  // Null if the standard input is polled
+	bool m_polled;
+	std::string m_received;  // Polled characters not returned as a line yet
+	bool m_inputEnded;
+	std::string m_path;
+	u32 m_lineNumber;
+	u32 m_startCycle;
+	u32 m_entryCycle;   // When the current entry is due
+	u32 m_spacing;
+	std::vector<u16> m_keys; // Keys of the current entry
+	u32 m_nextKey;
+	u32 m_typedKeys;
+	u32 m_waitCount;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_KEYSCRIPT_HPP_INCLUDED
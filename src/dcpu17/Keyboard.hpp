@@ -5,14 +5,34 @@
 #define DCPU_GENERIC_KEYBOARD_MANUFACTURER_ID    0x1c6c8b36
 #define DCPU_GENERIC_KEYBOARD_VERSION            0x0001
 
-#define DCPU_GENERIC_KEYBOARD_BUFSIZE 16
+// Default number of keys the keyboard can hold before the DCPU reads them
+#define DCPU_GENERIC_KEYBOARD_BUFSIZE 64
+// Key codes which pressed state is tracked (0 to 255)
+#define DCPU_GENERIC_KEYBOARD_KEYS 256
 
+#include <vector>
 #include <SFML/Window.hpp>
 
 #include "HardwareDevice.hpp"
 
 namespace dcpu
 {
+// Key codes seen by the DCPU
+enum KeyboardCodes
+{
+	KB_BACKSPACE = 0x10,
+	KB_RETURN = 0x11,
+	KB_INSERT = 0x12,
+	KB_DELETE = 0x13,
+	KB_ASCII_BEG = 0x20,
+	KB_ASCII_END = 0x7f,
+	KB_UP = 0x80,
+	KB_DOWN = 0x81,
+	KB_LEFT = 0x82,
+	KB_RIGHT = 0x83,
+	KB_SHIFT = 0x90,
+	KB_CONTROL = 0x91
+};
 
 class Keyboard : public HardwareDevice
 {
@@ -25,25 +45,56 @@ public :
 		m_version = DCPU_GENERIC_KEYBOARD_VERSION;
 		m_name = "GenericKeyboard";
 		m_interruptMsg = 0;
-		clearBuffer();
+		m_droppedKeys = 0;
+		// Keys stay in the buffer, one interrupt is enough to read them
+		setCoalescing(true);
+		setBufferSize(DCPU_GENERIC_KEYBOARD_BUFSIZE);
+		clearKeyStates();
 	}
 
 	void onEvent(const sf::Event & e);
-	virtual void interrupt();
+
+	// Types a key from another input source (k is one of KeyboardCodes).
+	// Returns false if the key was dropped because the buffer is full.
+	bool typeKey(u16 k);
+
+	// Pressed state of a key, as answered to the DCPU.
+	// Updated by onEvent(), or by hand for other input sources.
+	// Letters are the same key in both cases.
+	void setKeyPressed(u16 k, bool pressed);
+	bool isKeyPressed(u16 k) const;
+
+	// Releases all keys
+	void clearKeyStates();
+
+	// Changes how many keys can wait for the DCPU (clears the buffer)
+	void setBufferSize(u16 size);
+	u16 getBufferSize() const { return m_buffer.size(); }
+
+	// True if the next key would be dropped
+	bool isBufferFull() const { return m_bufferCount == m_buffer.size(); }
+
+	// Number of keys dropped because the buffer was full
+	u32 getDroppedKeys() const { return m_droppedKeys; }
+
+	virtual void interrupt(RegisterFile & r);
+	virtual void disconnect();
 
 private:
 
-	void pushEvent(u16 k);
+	bool pushEvent(u16 k);
 	u16 nextEvent();
-	bool isKeyPressed(u16 k);
 	void clearBuffer();
 
 	// Attributes
 
-	u16 m_buffer[DCPU_GENERIC_KEYBOARD_BUFSIZE]; // cyclic buffer
+	std::vector<u16> m_buffer; // cyclic buffer
 	u16 m_bufferWritePos;
 	u16 m_bufferReadPos;
+	u16 m_bufferCount;
 	u16 m_interruptMsg;
+	u32 m_droppedKeys;
+	u32 m_keyStates[DCPU_GENERIC_KEYBOARD_KEYS / 32]; // One bit per key code
 
 };
 
@@ -25,41 +25,85 @@ void LEM1802::initDefaultPalette()
 {
 	for(u8 i = 0; i < 16; ++i)
 	{
-		bool bright = i & 0b1000;
-		sf::Color c(0,0,0,255);
+		const u16 level = (i & 0b1000) ? 0xf : 0x7; // bright or not
+		u16 w = 0;
 
 		if(i & 0b0100)
-		{
-			c.r = 127;
-			if(bright)
-				c.r += 128;
-		}
+			w |= level << 8;
 		if(i & 0b0010)
-		{
-			c.g = 127;
-			if(bright)
-				c.g += 128;
-		}
+			w |= level << 4;
 		if(i & 0b0001)
-		{
-			c.b = 127;
-			if(bright)
-				c.b += 128;
-		}
+			w |= level;
 
-		m_defaultPalette[i] = c;
+		m_defaultPalette[i] = w;
 	}
 }
 
 void LEM1802::loadDefaultPalette()
 {
-	memcpy(m_palette, m_defaultPalette, 16 * sizeof(sf::Color));
+	memcpy(m_paletteWords, m_defaultPalette, 16 * sizeof(u16));
+	buildColorTables();
+}
+
+void LEM1802::updateMappings()
+{
+	unobserveAll();
+
+	if(m_vramAddr != 0)
+		observe(m_vramAddr, DCPU_LEM1802_VRAM_SIZE);
+	if(m_fontAddr != 0)
+		observe(m_fontAddr, DCPU_LEM1802_FONT_SIZE);
+	if(m_paletteAddr != 0)
+		observe(m_paletteAddr, 16);
+}
+
+void LEM1802::onMemoryWrite(u16 addr, u16 value)
+{
+	// Mapped ranges may overlap, a word can belong to several of them
+	if(m_vramAddr != 0 && addr >= m_vramAddr && addr - m_vramAddr < DCPU_LEM1802_VRAM_SIZE)
+	{
+		const u16 i = addr - m_vramAddr;
+		m_dirtyTiles[i >> 5] |= (u32)1 << (i & 31);
+		m_vramDirty = true;
+		m_changed = true;
+	}
+
+	// The font and the palette stay mapped, the program can change them at any time
+	if(m_fontAddr != 0 && addr >= m_fontAddr && addr - m_fontAddr < DCPU_LEM1802_FONT_SIZE)
+	{
+		m_font[addr - m_fontAddr] = value;
+		m_redrawAll = true;
+		m_changed = true;
+	}
+
+	if(m_paletteAddr != 0 && addr >= m_paletteAddr && addr - m_paletteAddr < 16
+	&& m_paletteWords[addr - m_paletteAddr] != value)
+	{
+		m_paletteWords[addr - m_paletteAddr] = value;
+		buildColorTables();
+	}
+}
+
+void LEM1802::buildColorTables()
+{
+	for(u16 i = 0; i < 16; ++i)
+		m_packedPalette[i] = unpackPaletteWord(m_paletteWords[i]);
+
+	// Index is the high byte of a VRAM word: ffffbbbb
+	for(u16 i = 0; i < 256; ++i)
+	{
+		m_tileColors[i].fg = m_packedPalette[(i >> 4) & 0xf];
+		m_tileColors[i].bg = m_packedPalette[i & 0xf];
+	}
+
+	m_redrawAll = true;
+	m_changed = true;
 }
 
-void LEM1802::interrupt()
+void LEM1802::interrupt(RegisterFile & r)
 {
 	assert(r_dcpu != 0);
-	u16 a = r_dcpu->getRegister(AD_A);
+	u16 a = r[AD_A];
 
 #ifdef DCPU_DEBUG
 	std::cout << "I: " << m_name << ": received interrupt code " << FORMAT_HEX(a) << std::endl;
@@ -68,27 +112,27 @@ void LEM1802::interrupt()
 	switch(a)
 	{
 	case MEM_MAP_SCREEN:
-		intMapScreen();
+		intMapScreen(r[AD_B]);
 		break;
 
 	case MEM_MAP_FONT:
-		intMapFont();
+		intMapFont(r[AD_B]);
 		break;
 
 	case MEM_MAP_PALETTE:
-		intMapPalette();
+		intMapPalette(r[AD_B]);
 		break;
 
 	case SET_BORDER_COLOR:
-		intSetBorderColor();
+		intSetBorderColor(r[AD_B]);
 		break;
 
 	case MEM_DUMP_FONT:
-		intDumpFont();
+		intDumpFont(r[AD_B]);
 		break;
 
 	case MEM_DUMP_PALETTE:
-		intDumpPalette();
+		intDumpPalette(r[AD_B]);
 		break;
 
 	default:
@@ -100,7 +144,7 @@ void LEM1802::interrupt()
 	}
 }
 
-void LEM1802::intMapScreen()
+void LEM1802::intMapScreen(u16 b)
 {
 	// Reads the B register, and maps the video ram to DCPU-16 ram starting
 	// at address B. If B is 0, the screen is disconnected.
@@ -108,8 +152,9 @@ void LEM1802::intMapScreen()
 	// about one second to start up. Other interrupts sent during this time
 	// are still processed.
 	assert(r_dcpu != 0);
-	u16 b = r_dcpu->getRegister(AD_B);
 	m_vramAddr = b;
+	m_redrawAll = true;
+	m_changed = true;
 
 #ifdef DCPU_DEBUG
 	std::cout << "I: " << m_name
@@ -118,11 +163,24 @@ void LEM1802::intMapScreen()
 
 	// TODO LEM1802: 1s delay if b goes from 0 to any other value
 
+	updateMappings();
+
 	if(b == 0)
-		disconnect();
+	{
+		// The device stays connected, it just shows nothing
+		cancelWakeUp(EVENT_BLINK);
+		return;
+	}
+
+	// Blink timing follows guest time
+	if(!isWakeUpPending(EVENT_BLINK))
+	{
+		m_blinkVisible = true;
+		wakeUpIn(DCPU_LEM1802_BLINK_CYCLES, EVENT_BLINK);
+	}
 }
 
-void LEM1802::intMapFont()
+void LEM1802::intMapFont(u16 addr)
 {
 	// Reads the B register, and maps the font ram to DCPU-16 ram starting
 	// at address B.
@@ -134,20 +192,20 @@ void LEM1802::intMapFont()
 		return;
 #endif
 
-	u16 addr = r_dcpu->getRegister(AD_B);
-
 	if(addr == 0)
 	{
 #ifdef DCPU_DEBUG
 		std::cout << "I: " << m_name << ": Mapping default font" << std::endl;
 #endif
-		// TODO: LEM1802: this font should be preloaded
-		std::string path = DCPU_ASSETS_DIR;
-		loadDefaultFontFromImage(path + "/lem1802/charset.png");
+		memcpy(m_font, m_defaultFont, DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+		m_fontAddr = 0;
+		m_redrawAll = true;
+		m_changed = true;
+		updateMappings();
 		return;
 	}
 
-	if(DCPU_RAM_SIZE - addr < 256)
+	if(DCPU_RAM_SIZE - addr < DCPU_LEM1802_FONT_SIZE)
 	{
 		std::cout << "E: " << m_name
 			<< ": Can't map font from adress "
@@ -159,45 +217,17 @@ void LEM1802::intMapFont()
 	std::cout << "I: " << m_name << ": Mapping font to addr=" << FORMAT_HEX(addr) << std::endl;
 #endif
 
-	// For each glyph
-	for(u16 k = 0; k < 128; ++k, addr += 2)
-	{
-		// Get fontcode
-		u32 w1 = r_dcpu->getMemory(addr);
-		u32 w2 = r_dcpu->getMemory(addr+1);
-		// Font example with letter 'F':
-		// word0 = 11111111 /
-		//         00001001
-		// word1 = 00001001 /
-		//         00000000
-		u32 fontcode = (w1 << 16) | w2; // Note : '<<' is always a logical shift
-
-		// Get glyph pos
-		u16 cx = (k % DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_W;
-		u16 cy = (k / DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_H;
-
-		// Decode fontcode
-		for(u16 i = 0; i < DCPU_LEM1802_TILE_W; ++i)
-		for(u16 j = 0; j < DCPU_LEM1802_TILE_H; ++j)
-		{
-			u16 x = cx + i;
-			u16 y = cy + DCPU_LEM1802_TILE_H - 1 - j;
-
-			if(fontcode > 0x7fffffff)
-				m_fontPixels.setPixel(x, y, sf::Color(255,255,255,255));
-			else
-				m_fontPixels.setPixel(x, y, sf::Color(0,0,0,0));
-
-			fontcode <<= 1;
-		}
-	}
-
-	m_font.loadFromImage(m_fontPixels);
+	for(u16 i = 0; i < DCPU_LEM1802_FONT_SIZE; ++i)
+		m_font[i] = r_dcpu->getMemory(addr + i);
+	m_fontAddr = addr;
+	m_redrawAll = true;
+	m_changed = true;
+	updateMappings();
 
 	r_dcpu->halt(256);
 }
 
-void LEM1802::intMapPalette()
+void LEM1802::intMapPalette(u16 paletteAddr)
 {
 	// Reads the B register, and maps the palette ram to DCPU-16 ram starting
 	// at address B.
@@ -205,7 +235,16 @@ void LEM1802::intMapPalette()
 
 	assert(r_dcpu != 0);
 
-	u16 paletteAddr = r_dcpu->getRegister(AD_B);
+	if(paletteAddr == 0)
+	{
+#ifdef DCPU_DEBUG
+		std::cout << "I: " << m_name << ": Mapping default palette" << std::endl;
+#endif
+		m_paletteAddr = 0;
+		loadDefaultPalette();
+		updateMappings();
+		return;
+	}
 
 	if(paletteAddr + 16 > DCPU_RAM_SIZE)
 	{
@@ -220,30 +259,28 @@ void LEM1802::intMapPalette()
 	std::cout << "I: " << m_name
 		<< ": Mapping palette to address " << FORMAT_HEX(paletteAddr) << std::endl;
 #endif
-	for(u16 i = 0; i < 16; ++i)
-	{
-		u16 w = r_dcpu->getMemory(paletteAddr+i);
-		m_palette[i].r = ((w >> 8) & 0xf) << 4;
-		m_palette[i].g = ((w >> 4) & 0xf) << 4;
-		m_palette[i].b = (w & 0xf) << 4;
-	}
+	m_paletteAddr = paletteAddr;
+	memcpy(m_paletteWords, r_dcpu->getMemory() + m_paletteAddr, 16 * sizeof(u16));
+	buildColorTables();
+	updateMappings();
 }
 
-void LEM1802::intSetBorderColor()
+void LEM1802::intSetBorderColor(u16 b)
 {
 	// Reads the B register, and sets the border color to palette index B&0xF
 	assert(r_dcpu != 0);
 
-	u16 i = r_dcpu->getRegister(AD_B) & 0xf;
+	u16 i = b & 0xf;
 
 #ifdef DCPU_DEBUG
 	std::cout << "I: " << m_name << ": intSetBorderColor: set to color " << FORMAT_HEX(i) << std::endl;
 #endif
 
-	m_borderColor = m_palette[i];
+	m_borderColor = i;
+	m_changed = true;
 }
 
-void LEM1802::intDumpFont()
+void LEM1802::intDumpFont(u16 addr)
 {
 	// Reads the B register, and writes the default font data to DCPU-16 ram
 	// starting at address B.
@@ -251,8 +288,6 @@ void LEM1802::intDumpFont()
 
 	assert(r_dcpu != 0);
 
-	u16 addr = r_dcpu->getRegister(AD_B);
-
 	// Check if the address is valid
 	if(addr + 256 > DCPU_RAM_SIZE)
 	{
@@ -268,42 +303,13 @@ void LEM1802::intDumpFont()
 		<< ": Dumping default font to address " << FORMAT_HEX(addr) << std::endl;
 #endif
 
-	// For each glyph
-	for(u16 k = 0; k < 128; ++k, addr += 2)
-	{
-		// Font example with letter 'F':
-		// word0 = 11111111 /
-		//         00001001
-		// word1 = 00001001 /
-		//         00000000
-
-		u16 cx = (k % DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_W;
-		u16 cy = (k / DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_H;
-
-		// Encode fontcode
-		u32 fontcode=0;
-		for(u16 i = 0; i < DCPU_LEM1802_TILE_W; ++i)
-		for(u16 j = 0; j < DCPU_LEM1802_TILE_H; ++j)
-		{
-			u32 x = cx + i;
-			u32 y = cy + DCPU_LEM1802_TILE_H - 1 - j;
-
-			sf::Color c = m_defaultFontPixels.getPixel(x, y);
-
-			fontcode <<= 1;
-			if(c.r != 0)
-				fontcode |= 1;
-		}
-
-		// Set fontcode
-		r_dcpu->setMemory(addr, (fontcode >> 16) & 0xffff);
-		r_dcpu->setMemory(addr+1, fontcode & 0xffff);
-	}
+	for(u16 i = 0; i < DCPU_LEM1802_FONT_SIZE; ++i)
+		r_dcpu->setMemory(addr + i, m_defaultFont[i]);
 
 	r_dcpu->halt(256);
 }
 
-void LEM1802::intDumpPalette()
+void LEM1802::intDumpPalette(u16 paletteAddr)
 {
 	// Reads the B register, and writes the default palette data to DCPU-16
 	// ram starting at address B.
@@ -311,8 +317,6 @@ void LEM1802::intDumpPalette()
 
 	assert(r_dcpu != 0);
 
-	u16 paletteAddr = r_dcpu->getRegister(AD_B);
-
 	// Check address
 	if(paletteAddr + 16 > DCPU_RAM_SIZE)
 	{
@@ -328,43 +332,193 @@ void LEM1802::intDumpPalette()
 		<< ": Dumping palette to address " << FORMAT_HEX(paletteAddr) << std::endl;
 #endif
 	for(u16 i = 0; i < 16; ++i)
-	{
-		u16 w = m_defaultPalette[i].b;
-		w |= m_defaultPalette[i].g << 4;
-		w |= m_defaultPalette[i].r << 8;
-		r_dcpu->setMemory(paletteAddr+i, w);
-	}
+		r_dcpu->setMemory(paletteAddr+i, m_defaultPalette[i]);
 
 	r_dcpu->halt(16);
 }
 
+void LEM1802::loadDefaultFont()
+{
+	memcpy(m_defaultFont, g_lem1802DefaultFont, DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+	if(m_fontAddr == 0)
+	{
+		memcpy(m_font, m_defaultFont, DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+		m_redrawAll = true;
+		m_changed = true;
+	}
+}
+
 bool LEM1802::loadDefaultFontFromImage(const std::string & filename)
 {
-	if(!m_defaultFontPixels.loadFromFile(filename))
+	sf::Image img;
+	if(!img.loadFromFile(filename))
 	{
 		std::cout << "E: " << m_name << ": couldn't load font asset '" << filename << "'" << std::endl;
 		return false;
 	}
-	// Replace non-white by alpha 0
-	for(u32 y = 0; y < m_defaultFontPixels.getSize().y; ++y)
-	for(u32 x = 0; x < m_defaultFontPixels.getSize().x; ++x)
+
+	if(img.getSize().x < DCPU_LEM1802_CHARSET_W * DCPU_LEM1802_TILE_W
+	|| img.getSize().y < DCPU_LEM1802_CHARSET_H * DCPU_LEM1802_TILE_H)
 	{
-		const sf::Color & pix = m_defaultFontPixels.getPixel(x, y);
-		if(pix.r != 255 && pix.g != 255 && pix.b != 255)
-		{
-			m_defaultFontPixels.setPixel(x, y, sf::Color(0,0,0,0));
-		}
+		std::cout << "E: " << m_name << ": font asset '" << filename << "' is too small" << std::endl;
+		return false;
 	}
 
-	m_font.loadFromImage(m_defaultFontPixels);
-	m_font.setSmooth(false);
+	encodeFont(img, m_defaultFont);
+	if(m_fontAddr == 0)
+	{
+		memcpy(m_font, m_defaultFont, DCPU_LEM1802_FONT_SIZE * sizeof(u16));
+		m_redrawAll = true;
+		m_changed = true;
+	}
 
 	return true;
 }
 
-void LEM1802::update(float delta)
+void LEM1802::decodeFont(const u16 fontcodes[DCPU_LEM1802_FONT_SIZE], sf::Image & img)
 {
-	// TODO LEM1802: update
+	img.create(
+		DCPU_LEM1802_CHARSET_W * DCPU_LEM1802_TILE_W,
+		DCPU_LEM1802_CHARSET_H * DCPU_LEM1802_TILE_H,
+		sf::Color(0,0,0,0));
+
+	// For each glyph
+	for(u16 k = 0; k < 128; ++k)
+	{
+		// Font example with letter 'F':
+		// word0 = 11111111 /
+		//         00001001
+		// word1 = 00001001 /
+		//         00000000
+		u32 w1 = fontcodes[2*k];
+		u32 w2 = fontcodes[2*k+1];
+		u32 fontcode = (w1 << 16) | w2; // Note : '<<' is always a logical shift
+
+		// Get glyph pos
+		u16 cx = (k % DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_W;
+		u16 cy = (k / DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_H;
+
+		// Decode fontcode
+		for(u16 i = 0; i < DCPU_LEM1802_TILE_W; ++i)
+		for(u16 j = 0; j < DCPU_LEM1802_TILE_H; ++j)
+		{
+			u16 x = cx + i;
+			u16 y = cy + DCPU_LEM1802_TILE_H - 1 - j;
+
+			if(fontcode > 0x7fffffff)
+				img.setPixel(x, y, sf::Color(255,255,255,255));
+
+			fontcode <<= 1;
+		}
+	}
+}
+
+void LEM1802::encodeFont(const sf::Image & img, u16 fontcodes[DCPU_LEM1802_FONT_SIZE])
+{
+	// For each glyph
+	for(u16 k = 0; k < 128; ++k)
+	{
+		u16 cx = (k % DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_W;
+		u16 cy = (k / DCPU_LEM1802_CHARSET_W) * DCPU_LEM1802_TILE_H;
+
+		// Encode fontcode
+		u32 fontcode = 0;
+		for(u16 i = 0; i < DCPU_LEM1802_TILE_W; ++i)
+		for(u16 j = 0; j < DCPU_LEM1802_TILE_H; ++j)
+		{
+			u32 x = cx + i;
+			u32 y = cy + DCPU_LEM1802_TILE_H - 1 - j;
+
+			const sf::Color c = img.getPixel(x, y);
+
+			fontcode <<= 1;
+			if(c.r == 255 && c.g == 255 && c.b == 255)
+				fontcode |= 1;
+		}
+
+		fontcodes[2*k] = (fontcode >> 16) & 0xffff;
+		fontcodes[2*k+1] = fontcode & 0xffff;
+	}
+}
+
+void LEM1802::onScheduledEvent(u16 id, u32 cycle)
+{
+	if(id != EVENT_BLINK || r_dcpu == 0)
+		return;
+
+	// Only tiles with the blink bit will be redrawn
+	m_blinkVisible = !m_blinkVisible;
+	m_blinkDirty = true;
+	m_changed = true;
+
+	// Scheduling from the deadline (not the current cycle) avoids drift
+	wakeUpAt(cycle + DCPU_LEM1802_BLINK_CYCLES, EVENT_BLINK);
+}
+
+bool LEM1802::renderPixels()
+{
+	if(r_dcpu == 0 || m_vramAddr == 0)
+		return false;
+
+	// Nothing was stored to the mapped RAM since the last render
+	if(!m_redrawAll && !m_vramDirty && !m_blinkDirty)
+		return false;
+
+	const u16 * vram = r_dcpu->getMemory() + m_vramAddr;
+	const u16 vramSize = DCPU_RAM_SIZE - m_vramAddr < DCPU_LEM1802_VRAM_SIZE ?
+		DCPU_RAM_SIZE - m_vramAddr : DCPU_LEM1802_VRAM_SIZE;
+
+	bool changed = false;
+	u16 i = 0;
+	for(u16 y = 0; y < DCPU_LEM1802_NTILES_Y; ++y)
+	for(u16 x = 0; x < DCPU_LEM1802_NTILES_X; ++x, ++i)
+	{
+		const u16 word = i < vramSize ? vram[i] : 0;
+		const bool written = (m_dirtyTiles[i >> 5] >> (i & 31)) & 1;
+		if(m_redrawAll || (written && word != m_vramCache[i]) || (m_blinkDirty && (word & 0x0080)))
+		{
+			m_vramCache[i] = word;
+			renderTile(x, y, word);
+			changed = true;
+		}
+	}
+
+	m_redrawAll = false;
+	m_blinkDirty = false;
+	m_vramDirty = false;
+	memset(m_dirtyTiles, 0, sizeof(m_dirtyTiles));
+	if(changed)
+		++m_pixelsVersion;
+	return changed;
+}
+
+void LEM1802::renderTile(u16 x, u16 y, u16 word)
+{
+	const TileColors & colors = m_tileColors[word >> 8];
+	const u32 bg = colors.bg;
+	// Blinking characters are hidden every other blink period
+	const u32 fg = (word & 0x0080) && !m_blinkVisible ? bg : colors.fg;
+	const u32 diff = fg ^ bg;
+
+	// One byte per glyph column, bit 0 is the top row
+	const u16 c = word & 0x007f;
+	const u16 w1 = m_font[2*c];
+	const u16 w2 = m_font[2*c+1];
+	const u8 columns[DCPU_LEM1802_TILE_W] = {
+		(u8)(w1 >> 8), (u8)(w1 & 0xff),
+		(u8)(w2 >> 8), (u8)(w2 & 0xff)
+	};
+
+	u32 * row = m_pixels + y * DCPU_LEM1802_TILE_H * DCPU_LEM1802_W + x * DCPU_LEM1802_TILE_W;
+	for(u16 j = 0; j < DCPU_LEM1802_TILE_H; ++j, row += DCPU_LEM1802_W)
+	{
+		for(u16 i = 0; i < DCPU_LEM1802_TILE_W; ++i)
+		{
+			// All ones if the pixel is set, zero otherwise
+			const u32 mask = -(u32)((columns[i] >> j) & 1);
+			row[i] = bg ^ (diff & mask);
+		}
+	}
 }
 
 void LEM1802::render(sf::RenderWindow & win)
@@ -375,52 +529,29 @@ void LEM1802::render(sf::RenderWindow & win)
 	if(m_vramAddr == 0)
 		return;
 
-	u16 x, y, addr = m_vramAddr;
-	sf::IntRect subRect;
-	sf::RectangleShape charBGRect(sf::Vector2f(DCPU_LEM1802_TILE_W, DCPU_LEM1802_TILE_H));
+	if(m_screen.getSize().x == 0)
+	{
+		m_screen.create(DCPU_LEM1802_W, DCPU_LEM1802_H);
+		m_screenSprite.setTexture(m_screen, true);
+		m_screenVersion = m_pixelsVersion - 1;
+	}
 
-	// Border and BG
+	// Pixels may also have been rendered for something else (capture...)
+	renderPixels();
+	if(m_screenVersion != m_pixelsVersion)
+	{
+		m_screen.update(reinterpret_cast<const sf::Uint8*>(m_pixels));
+		m_screenVersion = m_pixelsVersion;
+	}
+
+	// Border
+	const u32 border = getBorderColor();
 	sf::RectangleShape borderRect(sf::Vector2f(DCPU_LEM1802_W, DCPU_LEM1802_H));
 	borderRect.setFillColor(sf::Color(8,8,8,255));
-	borderRect.setOutlineColor(m_borderColor);
+	borderRect.setOutlineColor(sf::Color(border & 0xff, (border >> 8) & 0xff, (border >> 16) & 0xff));
 	win.draw(borderRect);
 
-	// Tiles
-	for(y = 0; y < DCPU_LEM1802_NTILES_Y; ++y)
-	for(x = 0; x < DCPU_LEM1802_NTILES_X; ++x, ++addr)
-	{
-		u16 word = r_dcpu->getMemory(addr);
-		u8 c = word & 0x007f;
-		//bool blink = (word & 0x0080) != 0; // TODO LEM1802: handle blink
-
-		const sf::Color & fclr = m_palette[(word >> 12) & 0xf]; // Foreground
-		const sf::Color & bclr = m_palette[(word >> 8) & 0xf]; // Background
-
-		// Draw background
-		if(bclr.r || bclr.g || bclr.b)
-		{
-			charBGRect.setPosition(x * DCPU_LEM1802_TILE_W, y * DCPU_LEM1802_TILE_H);
-			charBGRect.setFillColor(bclr);
-			win.draw(charBGRect);
-		}
-
-		// Draw foreground
-
-		// Charset position
-		u16 cx = DCPU_LEM1802_TILE_W * (c % 32);
-		u16 cy = DCPU_LEM1802_TILE_H * (c / 32);
-
-		subRect.left = cx;
-		subRect.top = cy;
-		subRect.width = DCPU_LEM1802_TILE_W;
-		subRect.height = DCPU_LEM1802_TILE_H;
-
-		m_fontSprite.setTextureRect(subRect);
-		m_fontSprite.setPosition(x * DCPU_LEM1802_TILE_W, y * DCPU_LEM1802_TILE_H);
-		m_fontSprite.setColor(fclr);
-
-		win.draw(m_fontSprite);
-	}
+	win.draw(m_screenSprite);
 }
 
 } // namespace dcpu
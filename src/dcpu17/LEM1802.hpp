@@ -10,19 +10,39 @@
 #define DCPU_LEM1802_NTILES_X           32
 #define DCPU_LEM1802_NTILES_Y           12
 
+// Blinking characters are shown/hidden for this number of DCPU cycles
+#define DCPU_LEM1802_BLINK_CYCLES       (DCPU_STANDARD_FREQUENCY / 2)
+
 #define DCPU_LEM1802_CHARSET_W 			32
 #define DCPU_LEM1802_CHARSET_H 			4
 
-#define DCPU_LEM1802_VRAM_SIZE          DCPU_NTILES_X * DCPU_NTILES_Y
-#define DCPU_LEM1802_W                  DCPU_LEM1802_TILE_W * DCPU_LEM1802_NTILES_X
-#define DCPU_LEM1802_H                  DCPU_LEM1802_TILE_H * DCPU_LEM1802_NTILES_Y
+#define DCPU_LEM1802_VRAM_SIZE          (DCPU_LEM1802_NTILES_X * DCPU_LEM1802_NTILES_Y)
+#define DCPU_LEM1802_W                  (DCPU_LEM1802_TILE_W * DCPU_LEM1802_NTILES_X)
+#define DCPU_LEM1802_H                  (DCPU_LEM1802_TILE_H * DCPU_LEM1802_NTILES_Y)
 
 #include <SFML/Graphics.hpp>
 
 #include "HardwareDevice.hpp"
+#include "assets.hpp"
 
 namespace dcpu
 {
+// Packs a color the way it is laid out in RGBA pixel buffers
+// (byte order R, G, B, A in memory, assuming a little-endian host)
+inline u32 packColor(u8 r, u8 g, u8 b, u8 a = 255)
+{
+	return r | (g << 8) | (b << 16) | ((u32)a << 24);
+}
+
+// Converts a 12-bit LEM1802 color word (0x0RGB) into a packed color
+inline u32 unpackPaletteWord(u16 w)
+{
+	const u8 r = (w >> 8) & 0xf;
+	const u8 g = (w >> 4) & 0xf;
+	const u8 b = w & 0xf;
+	return packColor((r << 4) | r, (g << 4) | g, (b << 4) | b);
+}
+
 class LEM1802 : public HardwareDevice
 {
 public :
@@ -37,58 +57,162 @@ public :
 		MEM_DUMP_PALETTE    // 5
 	};
 
+	enum Events
+	{
+		EVENT_BLINK = 0
+	};
+
+	// Colors of a tile, indexed by the high byte of its VRAM word
+	struct TileColors
+	{
+		u32 fg;
+		u32 bg;
+	};
+
 	LEM1802() : HardwareDevice()
 	{
 		m_vramAddr = 0;
 		m_fontAddr = 0;
+		m_paletteAddr = 0;
 		m_name = "LEM1802";
 		m_HID = DCPU_LEM1802_HID;
 		m_manufacturerID = DCPU_LEM1802_MANUFACTURER_ID;
 		m_version = DCPU_LEM1802_VERSION;
-		m_borderColor = sf::Color(0,0,128);
+		m_borderColor = 1;
+		m_redrawAll = true;
+		m_blinkVisible = true;
+		m_blinkDirty = false;
+		m_vramDirty = false;
+		m_changed = true;
+		m_pixelsVersion = 0;
+		m_screenVersion = 0;
 
-		loadDefaultPalette();
-
-		m_fontPixels.create(
-			DCPU_LEM1802_CHARSET_W * DCPU_LEM1802_TILE_W,
-			DCPU_LEM1802_CHARSET_H * DCPU_LEM1802_TILE_H);
-
-		m_fontSprite.setTexture(m_font);
+		memset(m_vramCache, 0, DCPU_LEM1802_VRAM_SIZE * sizeof(u16));
+		memset(m_dirtyTiles, 0, sizeof(m_dirtyTiles));
+		memset(m_pixels, 0, DCPU_LEM1802_W * DCPU_LEM1802_H * sizeof(u32));
 
 		initDefaultPalette();
+		loadDefaultPalette();
+		loadDefaultFont();
 	}
 
 	virtual void connect(DCPU & dcpu);
 	virtual void disconnect();
 
-	virtual void interrupt();
-	virtual void update(float delta);
+	virtual void interrupt(RegisterFile & r);
+	virtual void onScheduledEvent(u16 id, u32 cycle);
+
+	// Mapped VRAM, font and palette react to DCPU stores
+	virtual void onMemoryWrite(u16 addr, u16 value);
 
-	void intMapScreen();
-	void intMapFont();
-	void intMapPalette();
-	void intSetBorderColor();
-	void intDumpFont();
-	void intDumpPalette();
+	void intMapScreen(u16 b);
+	void intMapFont(u16 addr);
+	void intMapPalette(u16 paletteAddr);
+	void intSetBorderColor(u16 b);
+	void intDumpFont(u16 addr);
+	void intDumpPalette(u16 paletteAddr);
 
+	// Uses the embedded charset as default font
+	void loadDefaultFont();
+
+	// Overrides the embedded default font with an image (128x32, white glyphs)
 	bool loadDefaultFontFromImage(const std::string & filename);
+
+	// Renders the screen into the RGBA pixel buffer.
+	// Only tiles that changed since the last call are redrawn.
+	// Returns true if any pixel changed.
+	bool renderPixels();
+
+	// Renders the screen in a window
 	void render(sf::RenderWindow & win);
 
+	// RGBA pixels of the screen (DCPU_LEM1802_W * DCPU_LEM1802_H, packed colors)
+	const u32 * getPixels() const { return m_pixels; }
+
+	// Incremented each time renderPixels() changes the pixels
+	u32 getPixelsVersion() const { return m_pixelsVersion; }
+
+	// Packed color of the border
+	u32 getBorderColor() const { return m_packedPalette[m_borderColor]; }
+
+	// State accessors (used to mirror the screen elsewhere)
+	u16 getVRAMAddr() const { return m_vramAddr; }
+	u8 getBorderColorIndex() const { return m_borderColor; }
+	const u16 * getFont() const { return m_font; }
+	const u16 * getPalette() const { return m_paletteWords; }
+	bool isBlinkVisible() const { return m_blinkVisible; }
+
+	// Shows or hides blinking characters, for screens that mirror
+	// another one instead of running their own blink events
+	void setBlinkVisible(bool visible)
+	{
+		if(visible != m_blinkVisible)
+		{
+			m_blinkVisible = visible;
+			m_blinkDirty = true;
+			m_changed = true;
+		}
+	}
+
+	// Returns true if VRAM, palette, font, border or blink changed
+	// since the last call
+	bool takeChanges()
+	{
+		const bool changed = m_changed;
+		m_changed = false;
+		return changed;
+	}
+	bool isDefaultFont() const { return m_fontAddr == 0; }
+
+	// Decodes 128 glyphs of fontcode words into a charset image
+	// (white glyphs over a transparent background).
+	static void decodeFont(const u16 fontcodes[DCPU_LEM1802_FONT_SIZE], sf::Image & img);
+
+	// Encodes a charset image (white glyphs, at least 128x32) into fontcode words
+	static void encodeFont(const sf::Image & img, u16 fontcodes[DCPU_LEM1802_FONT_SIZE]);
+
 private :
 
 	void initDefaultPalette();
 	void loadDefaultPalette();
 
-	sf::Texture m_font;
-	sf::Image m_fontPixels;
-	sf::Image m_defaultFontPixels;
-	sf::Sprite m_fontSprite;
-	sf::Color m_borderColor;
+	// Observes the mapped VRAM, font and palette ranges
+	void updateMappings();
+
+	// Rebuilds m_packedPalette and m_tileColors from m_paletteWords
+	void buildColorTables();
+
+	// Draws one tile into the pixel buffer
+	void renderTile(u16 x, u16 y, u16 word);
+
+	u8 m_borderColor; // Palette index
 
 	u16 m_vramAddr;
 	u16 m_fontAddr;
-	sf::Color m_palette[16];
-	sf::Color m_defaultPalette[16];
+	u16 m_paletteAddr;
+
+	u16 m_paletteWords[16];        // Current palette (12-bit colors)
+	u16 m_defaultPalette[16];
+	u32 m_packedPalette[16];       // m_paletteWords as packed colors
+	TileColors m_tileColors[256];  // Foreground/background pairs
+
+	u16 m_font[DCPU_LEM1802_FONT_SIZE];        // Fontcodes of the current font
+	u16 m_defaultFont[DCPU_LEM1802_FONT_SIZE]; // Fontcodes of the default font
+
+	u16 m_vramCache[DCPU_LEM1802_VRAM_SIZE]; // VRAM words of the last render
+	u32 m_dirtyTiles[(DCPU_LEM1802_VRAM_SIZE + 31) / 32]; // Tiles written since
+	bool m_vramDirty; // Set when any bit of m_dirtyTiles is set
+	bool m_redrawAll; // Set when the palette or the font changed
+	bool m_blinkVisible; // Are blinking characters currently shown?
+	bool m_blinkDirty;   // Set when blinking tiles must be redrawn
+	bool m_changed;      // Like the flags above, but cleared by takeChanges()
+	u32 m_pixels[DCPU_LEM1802_W * DCPU_LEM1802_H];
+	u32 m_pixelsVersion;
+
+	// Created on first render, so headless use needs no graphics context
+	sf::Texture m_screen;
+	sf::Sprite m_screenSprite;
+	u32 m_screenVersion; // Pixels version uploaded to m_screen
 
 };
 
@@ -0,0 +1,199 @@
+#include "Lexer.hpp"
+
+namespace dcpu
+{
+
+// Character classes
+enum
+{
+	CHAR_SPACE      = 1,
+	CHAR_EOL        = 2,
+	CHAR_NAME_BEGIN = 4,  // a-zA-Z_
+	CHAR_NAME       = 8,  // a-zA-Z_0-9
+	CHAR_DIGIT      = 16,
+	CHAR_HEX        = 32
+};
+
+static const u8 s_charClasses[256] =
+{
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  2,  0,  0,  2,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 1,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	56, 56, 56, 56, 56, 56, 56, 56, 56, 56,  0,  0,  0,  0,  0,  0,
+	 0, 44, 44, 44, 44, 44, 44, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+	12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,  0,  0,  0,  0, 12,
+	 0, 44, 44, 44, 44, 44, 44, 12, 12, 12, 12, 12, 12, 12, 12, 12,
+	12, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+	 0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0
+};
+
+inline u8 charClass(char c)
+{
+	return s_charClasses[static_cast<u8>(c)];
+}
+
+std::string Token::toString() const
+{
+	if(type == TOKEN_STRING)
+		return std::string(getStringBegin(), getStringSize());
+	if(type == TOKEN_DIRECTIVE)
+		return std::string(text + 1, size - 1);
+	return std::string(text, size);
+}
+
+std::string tokensToString(const Token * tokens, u32 count)
+{
+	std::string str;
+	for(u32 i = 0; i < count && !tokens[i].isEndOfLine(); ++i)
+	{
+		if(i != 0 && tokens[i].text != tokens[i-1].text + tokens[i-1].size)
+			str += ' ';
+		str.append(tokens[i].text, tokens[i].size);
+	}
+	return str;
+}
+
+Lexer::Lexer()
+{
+	reset(0, 0);
+}
+
+Lexer::Lexer(const char * data, u32 size)
+{
+	reset(data, size);
+}
+
+void Lexer::reset(const char * data, u32 size)
+{
+	m_begin = data;
+	m_pos = data;
+	m_end = data + size;
+	m_lineBegin = data;
+	m_row = 0;
+	m_isFirstOnLine = true;
+}
+
+void Lexer::next(Token & token)
+{
+	while(m_pos < m_end && (charClass(*m_pos) & CHAR_SPACE))
+		++m_pos;
+
+	const char * p = m_pos;
+	token.text = p;
+	token.row = m_row;
+	token.col = p - m_lineBegin;
+	token.value = 0;
+
+	if(p == m_end)
+	{
+		token.type = TOKEN_END;
+		token.size = 0;
+		return;
+	}
+
+	const u8 cc = charClass(*p);
+
+	if(cc & CHAR_EOL)
+	{
+		// LF, CR+LF or CR
+		if(*p == '\r' && p + 1 < m_end && p[1] == '\n')
+			++p;
+		++p;
+		token.type = TOKEN_END_OF_LINE;
+		++m_row;
+		m_lineBegin = p;
+		m_isFirstOnLine = true;
+	}
+	else if(cc & CHAR_NAME_BEGIN)
+	{
+		do ++p; while(p < m_end && (charClass(*p) & CHAR_NAME));
+		token.type = TOKEN_NAME;
+	}
+	else if(cc & CHAR_DIGIT)
+	{
+		u32 value = 0;
+		if(*p == '0' && p + 1 < m_end && (p[1] == 'x' || p[1] == 'X'))
+		{
+			p += 2;
+			const char * digits = p;
+			for(; p < m_end && (charClass(*p) & CHAR_HEX); ++p)
+			{
+				if(value < DCPU_LEXER_BIG_NUMBER)
+				{
+					const char c = *p;
+					value = (value << 4) + (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+				}
+			}
+			token.type = p != digits ? TOKEN_NUMBER : TOKEN_INVALID;
+		}
+		else
+		{
+			for(; p < m_end && (charClass(*p) & CHAR_DIGIT); ++p)
+			{
+				if(value < DCPU_LEXER_BIG_NUMBER)
+					value = value * 10 + (*p - '0');
+			}
+			token.type = TOKEN_NUMBER;
+		}
+		token.value = value < DCPU_LEXER_BIG_NUMBER ? value : DCPU_LEXER_BIG_NUMBER;
+
+		// Letters glued to a number (12ab, 0x1g)
+		if(p < m_end && (charClass(*p) & CHAR_NAME))
+		{
+			do ++p; while(p < m_end && (charClass(*p) & CHAR_NAME));
+			token.type = TOKEN_INVALID;
+		}
+	}
+	else if(*p == '"')
+	{
+		do ++p; while(p < m_end && *p != '"' && !(charClass(*p) & CHAR_EOL));
+		if(p < m_end && *p == '"')
+		{
+			++p;
+			token.type = TOKEN_STRING;
+		}
+		else
+			token.type = TOKEN_INVALID;
+	}
+	else if(*p == ';')
+	{
+		do ++p; while(p < m_end && !(charClass(*p) & CHAR_EOL));
+		token.type = TOKEN_COMMENT;
+	}
+	else if(*p == '#' && m_isFirstOnLine
+		&& p + 1 < m_end && (charClass(p[1]) & CHAR_NAME_BEGIN))
+	{
+		++p;
+		do ++p; while(p < m_end && (charClass(*p) & CHAR_NAME));
+		token.type = TOKEN_DIRECTIVE;
+	}
+	else
+	{
+		++p;
+		token.type = TOKEN_PUNCTUATION;
+	}
+
+	if(token.type != TOKEN_END_OF_LINE)
+		m_isFirstOnLine = false;
+
+	token.size = p - token.text;
+	m_pos = p;
+}
+
+const char * Lexer::getInvalidMessage(const Token & token)
+{
+	if(token.type != TOKEN_INVALID)
+		return "Valid token";
+	if(token.text[0] == '"')
+		return "Unterminated string";
+	return "Invalid numeric";
+}
+
+} // namespace dcpu
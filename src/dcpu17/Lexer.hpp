@@ -0,0 +1,103 @@
+#ifndef HEADER_DCPU_LEXER_HPP_INCLUDED
+#define HEADER_DCPU_LEXER_HPP_INCLUDED
+
+#include <string>
+#include "common.hpp"
+
+// Value of a TOKEN_NUMBER that doesn't fit in 16 bits
+#define DCPU_LEXER_BIG_NUMBER 0x10000
+
+namespace dcpu
+{
+
+enum TokenType
+{
+	TOKEN_END = 0,     // End of the source (also ends the last line)
+	TOKEN_END_OF_LINE, // LF, CR+LF or CR
+	TOKEN_NAME,        // a-zA-Z_ followed by a-zA-Z_0-9
+	TOKEN_NUMBER,      // 123 or 0x1f
+	TOKEN_STRING,      // "text", on one line
+	TOKEN_PUNCTUATION, // Any other single character: , [ ] + : ...
+	TOKEN_COMMENT,     // From ';' to the end of the line
+	TOKEN_DIRECTIVE,   // '#' followed by a name, first on its line
+	TOKEN_INVALID      // Unterminated string or malformed number
+};
+
+// A piece of source. Tokens point into the source, nothing is copied.
+struct Token
+{
+	const char * text; // First character
+	u32 size;
+	u32 row;
+	u32 col;
+	u32 value; // TOKEN_NUMBER only (DCPU_LEXER_BIG_NUMBER if > 0xffff)
+	u8 type;
+	u16 file; // Index of the source file (see Preprocessor::getFileNames)
+
+	Token() : text(0), size(0), row(0), col(0), value(0), type(TOKEN_END), file(0)
+	{}
+
+	bool isEndOfLine() const
+	{
+		return type == TOKEN_END_OF_LINE || type == TOKEN_END;
+	}
+
+	bool isPunctuation(char c) const
+	{
+		return type == TOKEN_PUNCTUATION && text[0] == c;
+	}
+
+	// Text of the token (of the string for TOKEN_STRING,
+	// of the name for TOKEN_DIRECTIVE)
+	std::string toString() const;
+
+	// Characters of a TOKEN_STRING, without the quotes
+	const char * getStringBegin() const { return text + 1; }
+	u32 getStringSize() const { return size - 2; }
+};
+
+// Writes tokens as text, until an end of line or count tokens.
+// Tokens that were adjacent in the source are glued,
+// others are separated by one space.
+std::string tokensToString(const Token * tokens, u32 count);
+
+//
+// Splits source text into tokens, scanning each character once.
+// Character classes come from a 256-entry table, so the lexer only
+// branches once per token kind. Whitespace (' ' and '\t') is skipped.
+//
+class Lexer
+{
+public :
+
+	Lexer();
+
+	// Starts lexing size characters at data.
+	// data must stay valid while the tokens are used.
+	Lexer(const char * data, u32 size);
+
+	void reset(const char * data, u32 size);
+
+	// Reads the next token. After the end of the source,
+	// TOKEN_END is returned again.
+	void next(Token & token);
+
+	// Offset of the next character to read
+	u32 getOffset() const { return m_pos - m_begin; }
+
+	// Returns a message describing why a token is TOKEN_INVALID
+	static const char * getInvalidMessage(const Token & token);
+
+private :
+
+	const char * m_begin;
+	const char * m_pos;
+	const char * m_end;
+	const char * m_lineBegin;
+	u32 m_row;
+	bool m_isFirstOnLine; // No token was read on this line yet
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_LEXER_HPP_INCLUDED
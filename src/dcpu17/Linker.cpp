@@ -0,0 +1,95 @@
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "Linker.hpp"
+#include "SymbolTable.hpp"
+
+// Object defining a label that is defined by several objects
+#define DCPU_LINKER_AMBIGUOUS 0xfffffffe
+
+namespace dcpu
+{
+void Linker::addObject(const ObjectFile & object, const std::string & name)
+{
+	m_objects.push_back(&object);
+	m_names.push_back(name);
+}
+
+bool Linker::link(u16 ram[DCPU_RAM_SIZE])
+{
+	m_exceptionString.clear();
+	std::memset(ram, 0, DCPU_RAM_SIZE * sizeof(u16));
+
+	// Where each section goes
+	std::vector<u32> bases(m_objects.size());
+	u32 size = 0;
+	for(u32 i = 0; i < m_objects.size(); ++i)
+	{
+		bases[i] = size;
+		size += m_objects[i]->section.size();
+		if(size > DCPU_RAM_SIZE)
+		{
+			std::stringstream ss;
+			ss << "Out of memory when adding '" << m_names[i] << "'";
+			m_exceptionString = ss.str();
+			return false;
+		}
+	}
+
+	// Exported labels, with the object defining them
+	SymbolTable symbols;
+	std::vector<u32> addresses;
+	std::vector<u32> owners;
+	for(u32 i = 0; i < m_objects.size(); ++i)
+	{
+		const std::vector<ObjectSymbol> & exports = m_objects[i]->exports;
+		for(u32 j = 0; j < exports.size(); ++j)
+		{
+			const u32 id = symbols.intern(exports[j].name);
+			if(id == addresses.size())
+			{
+				addresses.push_back(bases[i] + exports[j].addr);
+				owners.push_back(i);
+			}
+			else
+				owners[id] = DCPU_LINKER_AMBIGUOUS;
+		}
+	}
+
+	for(u32 i = 0; i < m_objects.size(); ++i)
+	{
+		const ObjectFile & object = *m_objects[i];
+		std::copy(object.section.begin(), object.section.end(), ram + bases[i]);
+
+		for(u32 j = 0; j < object.relocations.size(); ++j)
+		{
+			const Relocation & r = object.relocations[j];
+			u16 & word = ram[bases[i] + r.addr];
+
+			if(r.import == DCPU_RELOCATION_LOCAL)
+			{
+				word += bases[i];
+				continue;
+			}
+
+			const std::string & name = object.imports[r.import];
+			const u32 id = symbols.find(name);
+			if(id == DCPU_SYMBOL_NONE || owners[id] == DCPU_LINKER_AMBIGUOUS)
+			{
+				std::stringstream ss;
+				ss << (id == DCPU_SYMBOL_NONE ? "Undefined" : "Ambiguous")
+					<< " label '" << name << "', used by '" << m_names[i] << "'";
+				if(id != DCPU_SYMBOL_NONE)
+					ss << " (defined by several objects)";
+				m_exceptionString = ss.str();
+				return false;
+			}
+			word = addresses[id];
+		}
+	}
+
+	return true;
+}
+
+} // namespace dcpu
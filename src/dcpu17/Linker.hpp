@@ -0,0 +1,48 @@
+#ifndef HEADER_DCPU_LINKER_HPP_INCLUDED
+#define HEADER_DCPU_LINKER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "ObjectFile.hpp"
+
+namespace dcpu
+{
+/*
+	Combines objects into a program.
+
+	Sections are placed one after the other from address 0, in the order
+	objects were added (so the first one is where the program starts).
+	Imported labels are searched in the exports of all objects.
+	A label can be defined by several objects as long as no object
+	imports it (each object uses its own).
+*/
+class Linker
+{
+public :
+
+	// Adds an object to the program.
+	// It is not copied, and must stay valid until link() returns.
+	// name is used in error messages.
+	void addObject(const ObjectFile & object, const std::string & name);
+
+	// Writes the program into ram.
+	// Returns false if an error occurred.
+	bool link(u16 ram[DCPU_RAM_SIZE]);
+
+	const std::string & getExceptionString() const
+	{ return m_exceptionString; }
+
+	bool isException() const
+	{ return !m_exceptionString.empty(); }
+
+private :
+
+	std::vector<const ObjectFile*> m_objects;
+	std::vector<std::string> m_names;
+	std::string m_exceptionString;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_LINKER_HPP_INCLUDED
@@ -0,0 +1,137 @@
+#ifndef HEADER_DCPU_LOCKFREE_HPP_INCLUDED
+#define HEADER_DCPU_LOCKFREE_HPP_INCLUDED
+
+#include "common.hpp"
+
+//
+// Lock-free handoffs between exactly two threads (one writer, one reader).
+// They rely on GCC atomic builtins, which MinGW also provides.
+//
+
+namespace dcpu
+{
+
+/*
+	Three copies of a value: the writer fills one, the reader uses another,
+	and the third holds the last complete value. Neither side ever waits,
+	and the reader always gets a consistent value (never a half-written one).
+*/
+template <class T>
+class TripleBuffer
+{
+public :
+
+	TripleBuffer()
+	{
+		m_back = 0;
+		m_state = 1;
+		m_front = 2;
+	}
+
+	// Writer side: value to fill, then publish()
+	T & back() { return m_buffers[m_back]; }
+
+	// Writer side: makes the back value the latest one
+	void publish()
+	{
+		m_back = exchange(m_back | FRESH) & INDEX_MASK;
+	}
+
+	// Reader side: takes the latest published value, if any.
+	// Returns false if nothing was published since the last call.
+	bool fetch()
+	{
+		if((m_state & FRESH) == 0)
+			return false;
+		m_front = exchange(m_front) & INDEX_MASK;
+		return true;
+	}
+
+	// Reader side: last fetched value
+	const T & front() const { return m_buffers[m_front]; }
+
+private :
+
+	enum
+	{
+		INDEX_MASK = 3,
+		FRESH = 4 // The middle buffer was not fetched yet
+	};
+
+	u32 exchange(u32 value)
+	{
+		u32 old;
+		do
+		{
+			old = m_state;
+		} while(__sync_val_compare_and_swap(&m_state, old, value) != old);
+		return old;
+	}
+
+	T m_buffers[3];
+	u32 m_back;           // Owned by the writer
+	u32 m_front;          // Owned by the reader
+	volatile u32 m_state; // Middle buffer index | FRESH
+};
+
+/*
+	Fixed-size FIFO. push() is called by one thread only,
+	pop() by one other thread only. N must be a power of two.
+*/
+template <class T, u32 N>
+class SPSCQueue
+{
+public :
+
+	SPSCQueue()
+	{
+		m_head = 0;
+		m_tail = 0;
+		m_overflows = 0;
+	}
+
+	// Writer side. Returns false (and counts an overflow) if the queue is full.
+	bool push(const T & value)
+	{
+		const u32 head = m_head;
+		if(head - m_tail == N)
+		{
+			++m_overflows;
+			return false;
+		}
+		m_items[head & (N - 1)] = value;
+		__sync_synchronize(); // The item is written before it becomes visible
+		m_head = head + 1;
+		return true;
+	}
+
+	// Reader side. Returns false if the queue is empty.
+	bool pop(T & value)
+	{
+		const u32 tail = m_tail;
+		if(tail == m_head)
+			return false;
+		__sync_synchronize();
+		value = m_items[tail & (N - 1)];
+		__sync_synchronize(); // The item is read before its slot is released
+		m_tail = tail + 1;
+		return true;
+	}
+
+	// Reader side. Returns true if there is nothing to pop.
+	bool isEmpty() const { return m_tail == m_head; }
+
+	// Number of values push() had to drop
+	u32 getOverflowCount() const { return m_overflows; }
+
+private :
+
+	T m_items[N];
+	volatile u32 m_head; // Number of pushed values
+	volatile u32 m_tail; // Number of popped values
+	u32 m_overflows;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_LOCKFREE_HPP_INCLUDED
@@ -0,0 +1,58 @@
+#include <string.h>
+#include "MemoryBus.hpp"
+
+namespace dcpu
+{
+MemoryBus::MemoryBus()
+{
+	memset(m_pageRanges, 0, DCPU_BUS_PAGE_COUNT * sizeof(u16));
+}
+
+void MemoryBus::map(IMemoryObserver * observer, u16 first, u32 size)
+{
+	if(size == 0)
+		return;
+
+	Range r;
+	r.first = first;
+	r.end = first + size;
+	if(r.end > 0x10000)
+		r.end = 0x10000;
+	r.observer = observer;
+
+	m_ranges.push_back(r);
+	countPages(r, 1);
+}
+
+void MemoryBus::unmap(IMemoryObserver * observer)
+{
+	u32 n = 0;
+	for(u32 i = 0; i < m_ranges.size(); ++i)
+	{
+		if(m_ranges[i].observer != observer)
+			m_ranges[n++] = m_ranges[i];
+		else
+			countPages(m_ranges[i], -1);
+	}
+	m_ranges.resize(n);
+}
+
+void MemoryBus::write(u16 addr, u16 value) const
+{
+	// The page is mapped, but maybe not this word
+	for(u32 i = 0; i < m_ranges.size(); ++i)
+	{
+		const Range & r = m_ranges[i];
+		if(addr >= r.first && addr < r.end)
+			r.observer->onMemoryWrite(addr, value);
+	}
+}
+
+void MemoryBus::countPages(const Range & r, s32 n)
+{
+	const u32 lastPage = (r.end - 1) >> DCPU_BUS_PAGE_SHIFT;
+	for(u32 p = r.first >> DCPU_BUS_PAGE_SHIFT; p <= lastPage; ++p)
+		m_pageRanges[p] += n;
+}
+
+} // namespace dcpu
@@ -0,0 +1,69 @@
+#ifndef HEADER_DCPU_MEMORYBUS_HPP_INCLUDED
+#define HEADER_DCPU_MEMORYBUS_HPP_INCLUDED
+
+#include <vector>
+#include "common.hpp"
+
+// Pages are the granularity of the mapped flags (256 words)
+#define DCPU_BUS_PAGE_SHIFT 8
+#define DCPU_BUS_PAGE_COUNT (0x10000 >> DCPU_BUS_PAGE_SHIFT)
+
+namespace dcpu
+{
+// Something that reacts when a DCPU memory word is written
+class IMemoryObserver
+{
+public :
+
+	virtual ~IMemoryObserver() {}
+
+	// Called after value has been stored at addr.
+	// Must not map or unmap ranges.
+	virtual void onMemoryWrite(u16 addr, u16 value) = 0;
+};
+
+//
+// Memory-mapped I/O: devices map address ranges and are told
+// when the DCPU stores to them.
+// Reads always go to RAM (a device keeps its mapped words up to date),
+// and stores only test a per-page flag, so unmapped memory stays
+// as fast as plain RAM.
+//
+class MemoryBus
+{
+public :
+
+	MemoryBus();
+
+	// Calls observer for each store in [first, first + size[
+	void map(IMemoryObserver * observer, u16 first, u32 size);
+
+	// Removes all ranges mapped by observer
+	void unmap(IMemoryObserver * observer);
+
+	// Returns true if a range touches the page of addr
+	bool isMapped(u16 addr) const { return m_pageRanges[addr >> DCPU_BUS_PAGE_SHIFT] != 0; }
+
+	// Tells observers of addr that value was stored there
+	void write(u16 addr, u16 value) const;
+
+private :
+
+	struct Range
+	{
+		u32 first;
+		u32 end; // First address after the range
+		IMemoryObserver * observer;
+	};
+
+	// Adds n to the ranges count of the pages touched by r
+	void countPages(const Range & r, s32 n);
+
+	std::vector<Range> m_ranges;
+	u16 m_pageRanges[DCPU_BUS_PAGE_COUNT]; // Number of ranges touching each page
+
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_MEMORYBUS_HPP_INCLUDED
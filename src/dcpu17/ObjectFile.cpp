@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <fstream>
+
+#include "ObjectFile.hpp"
+#include "utility.hpp"
+
+namespace dcpu
+{
+// Object files begin with this
+static const char s_magic[4] = {'D', 'C', 'P', 'O'};
+
+static void writeString(std::ostream & os, const std::string & str)
+{
+	writeU16(os, str.size());
+	os.write(str.data(), str.size());
+}
+
+static bool readString(std::istream & is, std::string & str)
+{
+	u16 size;
+	if(!readU16(is, size))
+		return false;
+	str.resize(size);
+	return size == 0 || is.read(&str[0], size);
+}
+
+void ObjectFile::set(const Assembler & assembler)
+{
+	const u16 * ram = assembler.getAssembly();
+	section.assign(ram, ram + assembler.getSize());
+
+	exports.clear();
+	imports.clear();
+	relocations.clear();
+
+	const SymbolTable & symbols = assembler.getSymbols();
+	std::vector<u32> importIndices(symbols.getCount(), DCPU_RELOCATION_LOCAL);
+	for(u32 i = 0; i < symbols.getCount(); ++i)
+	{
+		const u32 addr = assembler.getLabelAddress(i);
+		if(addr != DCPU_LABEL_UNDEFINED)
+			exports.push_back(ObjectSymbol(symbols.getName(i), addr));
+		else
+		{
+			importIndices[i] = imports.size();
+			imports.push_back(symbols.getName(i));
+		}
+	}
+
+	const std::vector<LabelUse> & uses = assembler.getLabelUses();
+	for(u32 i = 0; i < uses.size(); ++i)
+		relocations.push_back(Relocation(uses[i].addr, importIndices[uses[i].symbol]));
+}
+
+bool ObjectFile::load(const std::string & filename)
+{
+	std::ifstream ifs(filename.c_str(), std::ios::in|std::ios::binary);
+	if(!ifs.good())
+		return false;
+
+	char magic[4];
+	u32 version, count;
+	if(!ifs.read(magic, 4)
+		|| !std::equal(magic, magic + 4, s_magic)
+		|| !readU32(ifs, version) || version != DCPU_OBJECT_FILE_VERSION
+		|| !readU32(ifs, count) || count > DCPU_RAM_SIZE)
+		return false;
+
+	section.resize(count);
+	for(u32 i = 0; i < count; ++i)
+	{
+		if(!readU16(ifs, section[i]))
+			return false;
+	}
+
+	if(!readU32(ifs, count))
+		return false;
+	exports.resize(count);
+	for(u32 i = 0; i < count; ++i)
+	{
+		if(!readU16(ifs, exports[i].addr) || !readString(ifs, exports[i].name))
+			return false;
+	}
+
+	if(!readU32(ifs, count))
+		return false;
+	imports.resize(count);
+	for(u32 i = 0; i < count; ++i)
+	{
+		if(!readString(ifs, imports[i]))
+			return false;
+	}
+
+	if(!readU32(ifs, count))
+		return false;
+	relocations.resize(count);
+	for(u32 i = 0; i < count; ++i)
+	{
+		Relocation & r = relocations[i];
+		if(!readU16(ifs, r.addr) || !readU32(ifs, r.import))
+			return false;
+
+		// The linker doesn't check this again
+		if(r.addr >= section.size()
+			|| (r.import != DCPU_RELOCATION_LOCAL && r.import >= imports.size()))
+			return false;
+	}
+
+	return true;
+}
+
+bool ObjectFile::save(const std::string & filename) const
+{
+	std::ofstream ofs(filename.c_str(), std::ios::out|std::ios::trunc|std::ios::binary);
+	if(!ofs.good())
+		return false;
+
+	ofs.write(s_magic, 4);
+	writeU32(ofs, DCPU_OBJECT_FILE_VERSION);
+
+	writeU32(ofs, section.size());
+	for(u32 i = 0; i < section.size(); ++i)
+		writeU16(ofs, section[i]);
+
+	writeU32(ofs, exports.size());
+	for(u32 i = 0; i < exports.size(); ++i)
+	{
+		writeU16(ofs, exports[i].addr);
+		writeString(ofs, exports[i].name);
+	}
+
+	writeU32(ofs, imports.size());
+	for(u32 i = 0; i < imports.size(); ++i)
+		writeString(ofs, imports[i]);
+
+	writeU32(ofs, relocations.size());
+	for(u32 i = 0; i < relocations.size(); ++i)
+	{
+		writeU16(ofs, relocations[i].addr);
+		writeU32(ofs, relocations[i].import);
+	}
+
+	ofs.close();
+	return !ofs.fail();
+}
+
+} // namespace dcpu
@@ -0,0 +1,78 @@
+#ifndef HEADER_DCPU_OBJECTFILE_HPP_INCLUDED
+#define HEADER_DCPU_OBJECTFILE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "Assembler.hpp"
+
+// Must be incremented when the format of object files changes
+#define DCPU_OBJECT_FILE_VERSION 1
+
+// Relocation of a word holding an address in the object itself
+#define DCPU_RELOCATION_LOCAL 0xffffffff
+
+namespace dcpu
+{
+// A label defined by an object
+struct ObjectSymbol
+{
+	std::string name;
+	u16 addr; // From the beginning of the section
+
+	ObjectSymbol() : addr(0)
+	{}
+
+	ObjectSymbol(const std::string & name0, u16 addr0) : name(name0), addr(addr0)
+	{}
+};
+
+// A word of the section that holds an address
+struct Relocation
+{
+	u16 addr; // Of the word, from the beginning of the section
+	u32 import; // Index in ObjectFile::imports, or DCPU_RELOCATION_LOCAL
+
+	Relocation() : addr(0), import(DCPU_RELOCATION_LOCAL)
+	{}
+
+	Relocation(u16 addr0, u32 import0) : addr(addr0), import(import0)
+	{}
+};
+
+/*
+	A part of a program, assembled without knowing where it will be
+	in memory. Objects are combined into a program by a Linker.
+
+	DASM doesn't separate code from data, so an object has one section
+	holding both, in source order. Every label it defines is exported.
+	Each label use gets a relocation: local ones hold an address from
+	the beginning of the section (the linker adds where the section is),
+	others are imported from another object by name.
+
+	Object files are little-endian:
+	"DCPO", version, section size, words,
+	export count, (address, name size, name)...,
+	import count, (name size, name)...,
+	relocation count, (address, import)...
+*/
+struct ObjectFile
+{
+	std::vector<u16> section;
+	std::vector<ObjectSymbol> exports;
+	std::vector<std::string> imports;
+	std::vector<Relocation> relocations;
+
+	// Takes the result of an assembler (see Assembler::setRelocatable)
+	void set(const Assembler & assembler);
+
+	// Returns false if the file couldn't be read or is not valid
+	bool load(const std::string & filename);
+
+	// Returns false if the file couldn't be written
+	bool save(const std::string & filename) const;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_OBJECTFILE_HPP_INCLUDED
@@ -0,0 +1,48 @@
+#include "Pacer.hpp"
+
+namespace dcpu
+{
+
+Pacer::Pacer(u32 frequency, u32 maxBurst)
+{
+	m_frequency = frequency;
+	m_maxBurst = maxBurst;
+	reset();
+}
+
+void Pacer::reset()
+{
+	m_clock.restart();
+	m_due = 0;
+	m_done = 0;
+	m_skipped = 0;
+}
+
+u32 Pacer::getCycleBudget()
+{
+	// Integer math on microseconds: no rounding error accumulates
+	const sf::Uint64 elapsed = m_clock.getElapsedTime().asMicroseconds();
+	m_due = elapsed * m_frequency / 1000000 - m_skipped;
+
+	// Already ahead (the last instructions overshot the budget)
+	if(m_done >= m_due)
+		return 0;
+
+	sf::Uint64 debt = m_due - m_done;
+	if(debt > m_maxBurst)
+	{
+		// Too late to catch up, give up the excess
+		m_skipped += debt - m_maxBurst;
+		m_due -= debt - m_maxBurst;
+		debt = m_maxBurst;
+	}
+
+	return static_cast<u32>(debt);
+}
+
+void Pacer::consume(u32 cycles)
+{
+	m_done += cycles;
+}
+
+} // namespace dcpu
@@ -0,0 +1,59 @@
+#ifndef HEADER_DCPU_PACER_HPP_INCLUDED
+#define HEADER_DCPU_PACER_HPP_INCLUDED
+
+#include <SFML/System.hpp>
+#include "common.hpp"
+
+namespace dcpu
+{
+
+/*
+	Keeps the number of emulated cycles in line with real time.
+
+	Each call to getCycleBudget() measures the time elapsed since reset()
+	on a monotonic clock, and returns how many cycles are owed at the
+	given frequency. Cycles that actually ran are given back with
+	consume(), so instruction overshoot or a late frame is caught up
+	on the next budget instead of being lost.
+
+	If the host falls too far behind (debugger, suspended process...),
+	catching up is limited to maxBurst cycles per call, and the rest is
+	skipped and reported as drift.
+*/
+class Pacer
+{
+public :
+
+	Pacer(u32 frequency, u32 maxBurst);
+
+	// Starts counting from now, forgetting any debt and drift
+	void reset();
+
+	// Returns how many cycles must run now (at most maxBurst)
+	u32 getCycleBudget();
+
+	// Tells how many cycles actually ran since the last budget
+	void consume(u32 cycles);
+
+	// Cycles owed at the last budget, including those not run yet
+	// (negative if the guest is ahead)
+	s32 getLag() const { return static_cast<s32>(m_due - m_done); }
+
+	// Cycles given up since reset() because the host was too late
+	sf::Uint64 getSkippedCycles() const { return m_skipped; }
+
+	u32 getFrequency() const { return m_frequency; }
+
+private :
+
+	sf::Clock m_clock;
+	u32 m_frequency;
+	u32 m_maxBurst;
+	sf::Uint64 m_due;     // Cycles owed by real time (skipped ones excluded)
+	sf::Uint64 m_done;    // Cycles consumed
+	sf::Uint64 m_skipped; // Cycles given up
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_PACER_HPP_INCLUDED
@@ -0,0 +1,321 @@
+#include <algorithm>
+#include <fstream>
+
+#include "ParallelAssembler.hpp"
+
+namespace dcpu
+{
+// Returns the first token of the given line, or 0 if it is not in tokens
+static const Token * findLine(const Token * tokens, u32 count, u32 row, u32 file)
+{
+	for(u32 i = 0; i < count; ++i)
+	{
+		if(tokens[i].row == row && tokens[i].file == file)
+			return &tokens[i];
+
+		// Go to the end of the line
+		while(!tokens[i].isEndOfLine())
+			++i;
+	}
+	return 0;
+}
+
+// Assembles the chunks of a program
+class ParallelAssembler::ChunkTask : public IParallelTask
+{
+public :
+
+	const Token * tokens;
+	std::vector<u32> begins; // Index of the first token of each chunk, then the end
+	std::vector<Assembler*> assemblers;
+
+	virtual void runJob(u32 index)
+	{
+		Assembler & assembler = *assemblers[index];
+		assembler.setRelocatable(true); // Labels may be in other chunks
+		assembler.assembleTokens(tokens + begins[index], begins[index+1] - begins[index]);
+	}
+};
+
+// Preprocesses and assembles files
+class ParallelAssembler::FileTask : public IParallelTask
+{
+public :
+
+	ParallelAssembler * assembler;
+	SourceCache sources; // Shared by all files
+	const std::vector<std::string> * filenames;
+	std::vector<ObjectFile> * objects;
+	std::vector<std::string> errors; // Empty if no error
+
+	virtual void runJob(u32 index)
+	{
+		// Files are already assembled in parallel, so they are not split
+		assembler->assembleFile((*filenames)[index], sources,
+			(*objects)[index], errors[index], false);
+	}
+};
+
+ParallelAssembler::ParallelAssembler(u32 threadCount) : m_pool(threadCount)
+{}
+
+void ParallelAssembler::addIncludePath(const std::string & dir)
+{
+	m_includePaths.push_back(dir);
+}
+
+bool ParallelAssembler::assembleTokens(const std::vector<Token> & tokens,
+	ObjectFile & object, bool relocatable,
+	const std::vector<std::string> * fileNames)
+{
+	m_exceptionString.clear();
+
+	// Aim at a few chunks per thread, so threads finish at about the same time
+	u32 chunkSize = tokens.size() / (m_pool.getThreadCount() * 4);
+	if(chunkSize < DCPU_ASSEMBLER_MIN_CHUNK_SIZE)
+		chunkSize = DCPU_ASSEMBLER_MIN_CHUNK_SIZE;
+
+	ChunkTask task;
+	task.tokens = tokens.empty() ? 0 : &tokens[0];
+	task.begins.push_back(0);
+	if(m_pool.getThreadCount() > 1)
+	{
+		for(u32 i = 0; i + 1 < tokens.size(); ++i)
+		{
+			if(tokens[i].isEndOfLine()
+				&& i + 1 - task.begins.back() >= chunkSize
+				&& tokens[i+1].isPunctuation(':'))
+				task.begins.push_back(i + 1);
+		}
+	}
+	task.begins.push_back(tokens.size());
+
+	// Small programs are assembled as usual
+	if(task.begins.size() == 2)
+	{
+		Assembler assembler;
+		assembler.setRelocatable(relocatable);
+		assembler.setFileNames(fileNames);
+		if(!assembler.assembleTokens(tokens))
+		{
+			m_exceptionString = assembler.getExceptionString();
+			return false;
+		}
+		object.set(assembler);
+		return true;
+	}
+
+	const u32 chunkCount = task.begins.size() - 1;
+	for(u32 i = 0; i < chunkCount; ++i)
+	{
+		task.assemblers.push_back(new Assembler());
+		task.assemblers.back()->setFileNames(fileNames);
+	}
+
+#ifdef DCPU_DEBUG
+	std::cout << "Assembling " << chunkCount << " chunks on "
+		<< m_pool.getThreadCount() << " threads..." << std::endl;
+#endif
+
+	m_pool.run(task, chunkCount);
+
+	const bool res = mergeChunks(task, object, relocatable, fileNames);
+
+	for(u32 i = 0; i < chunkCount; ++i)
+		delete task.assemblers[i];
+	return res;
+}
+
+bool ParallelAssembler::mergeChunks(const ChunkTask & task,
+	ObjectFile & object, bool relocatable,
+	const std::vector<std::string> * fileNames)
+{
+	const std::vector<Assembler*> & chunks = task.assemblers;
+
+	// The first error in the source is reported
+	for(u32 i = 0; i < chunks.size(); ++i)
+	{
+		if(chunks[i]->isException())
+		{
+			m_exceptionString = chunks[i]->getExceptionString();
+			return false;
+		}
+	}
+
+	// Place chunks
+	std::vector<u32> bases(chunks.size());
+	u32 size = 0;
+	for(u32 i = 0; i < chunks.size(); ++i)
+	{
+		bases[i] = size;
+		size += chunks[i]->getSize();
+	}
+	if(size > DCPU_RAM_SIZE)
+	{
+		m_exceptionString = "Out of memory";
+		return false;
+	}
+
+	object.section.resize(size);
+	object.exports.clear();
+	object.imports.clear();
+	object.relocations.clear();
+
+	// Label addresses in the whole program.
+	// toGlobal gives the global ID of the labels of each chunk.
+	SymbolTable symbols;
+	std::vector<u32> addresses;
+	std::vector<std::vector<u32> > toGlobal(chunks.size());
+	for(u32 i = 0; i < chunks.size(); ++i)
+	{
+		const Assembler & chunk = *chunks[i];
+		const SymbolTable & chunkSymbols = chunk.getSymbols();
+		toGlobal[i].resize(chunkSymbols.getCount());
+
+		for(u32 s = 0; s < chunkSymbols.getCount(); ++s)
+		{
+			const std::string name = chunkSymbols.getName(s);
+			const u32 id = symbols.intern(name);
+			if(id == addresses.size())
+				addresses.push_back(DCPU_LABEL_UNDEFINED);
+			toGlobal[i][s] = id;
+
+			const u32 addr = chunk.getLabelAddress(s);
+			if(addr == DCPU_LABEL_UNDEFINED)
+				continue;
+			if(addresses[id] != DCPU_LABEL_UNDEFINED)
+			{
+				// Reported like Assembler does, at the second definition
+				const LabelUse & def = chunk.getLabelDefinition(s);
+				const u32 begin = task.begins[i];
+				const Token * line = findLine(task.tokens + begin,
+					task.begins[i+1] - begin, def.row, def.file);
+				m_exceptionString = Assembler::getLocatedMessage(
+					Assembler::getDefinedTwiceMessage(name),
+					def.row, def.col, def.file, fileNames, line);
+				return false;
+			}
+			addresses[id] = bases[i] + addr;
+		}
+
+		const u16 * ram = chunk.getAssembly();
+		std::copy(ram, ram + chunk.getSize(), object.section.begin() + bases[i]);
+	}
+
+	for(u32 id = 0; id < addresses.size(); ++id)
+	{
+		if(addresses[id] != DCPU_LABEL_UNDEFINED)
+			object.exports.push_back(ObjectSymbol(symbols.getName(id), addresses[id]));
+	}
+
+	// Label uses, in source order
+	std::vector<u32> importIndices(addresses.size(), DCPU_RELOCATION_LOCAL);
+	for(u32 i = 0; i < chunks.size(); ++i)
+	{
+		const std::vector<LabelUse> & uses = chunks[i]->getLabelUses();
+		for(u32 j = 0; j < uses.size(); ++j)
+		{
+			const LabelUse & use = uses[j];
+			const u32 id = toGlobal[i][use.symbol];
+			const u32 addr = bases[i] + use.addr;
+
+			if(addresses[id] != DCPU_LABEL_UNDEFINED)
+			{
+				object.section[addr] = addresses[id];
+				object.relocations.push_back(Relocation(addr, DCPU_RELOCATION_LOCAL));
+			}
+			else if(relocatable)
+			{
+				if(importIndices[id] == DCPU_RELOCATION_LOCAL)
+				{
+					importIndices[id] = object.imports.size();
+					object.imports.push_back(symbols.getName(id));
+				}
+				object.relocations.push_back(Relocation(addr, importIndices[id]));
+			}
+			else
+			{
+				m_exceptionString = Assembler::getLocatedMessage(
+					Assembler::getUndefinedLabelMessage(symbols.getName(id)),
+					use.row, use.col, use.file, fileNames);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+bool ParallelAssembler::assembleFile(const std::string & filename, SourceCache & sources,
+	ObjectFile & object, std::string & error, bool split)
+{
+	std::ifstream ifs(filename.c_str(), std::ios::in|std::ios::binary);
+	if(!ifs.good())
+	{
+		error = "couldn't open file";
+		return false;
+	}
+
+	Preprocessor preprocessor(ifs, filename);
+	preprocessor.setSourceCache(sources);
+	for(u32 i = 0; i < m_includePaths.size(); ++i)
+		preprocessor.addIncludePath(m_includePaths[i]);
+	std::vector<Token> tokens;
+	if(!preprocessor.process(tokens))
+	{
+		error = "Preprocessor: " + preprocessor.getExceptionString();
+		return false;
+	}
+
+	if(split)
+	{
+		if(!assembleTokens(tokens, object, true, &preprocessor.getFileNames()))
+		{
+			error = m_exceptionString;
+			return false;
+		}
+		return true;
+	}
+
+	Assembler assembler;
+	assembler.setRelocatable(true);
+	assembler.setFileNames(&preprocessor.getFileNames());
+	if(!assembler.assembleTokens(tokens))
+	{
+		error = assembler.getExceptionString();
+		return false;
+	}
+	object.set(assembler);
+	return true;
+}
+
+bool ParallelAssembler::assembleFiles(const std::vector<std::string> & filenames,
+	std::vector<ObjectFile> & objects)
+{
+	m_exceptionString.clear();
+	objects.resize(filenames.size());
+
+	FileTask task;
+	task.assembler = this;
+	task.filenames = &filenames;
+	task.objects = &objects;
+	task.errors.resize(filenames.size());
+
+	// A single file is split into chunks instead
+	if(filenames.size() == 1)
+		assembleFile(filenames[0], task.sources, objects[0], task.errors[0], true);
+	else
+		m_pool.run(task, filenames.size());
+
+	for(u32 i = 0; i < filenames.size(); ++i)
+	{
+		if(!task.errors[i].empty())
+		{
+			m_exceptionString = filenames[i] + ": " + task.errors[i];
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace dcpu
@@ -0,0 +1,88 @@
+#ifndef HEADER_DCPU_PARALLELASSEMBLER_HPP_INCLUDED
+#define HEADER_DCPU_PARALLELASSEMBLER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+
+#include "ObjectFile.hpp"
+#include "Preprocessor.hpp"
+#include "ThreadPool.hpp"
+
+// Minimum number of tokens in a chunk of a program assembled in parallel
+// (smaller programs are not worth splitting)
+#define DCPU_ASSEMBLER_MIN_CHUNK_SIZE 4096
+
+namespace dcpu
+{
+/*
+	Assembles on several threads.
+
+	Several files are preprocessed and assembled at the same time,
+	each into its own object (then see Linker).
+
+	A large program is split into chunks at lines beginning with a label.
+	Chunks are assembled at the same time as relocatable programs
+	starting at address 0, then merged: they are placed one after the
+	other and label uses are resolved across chunks. The result is the
+	same as assembling the program at once, because label addresses
+	always take a full word.
+*/
+class ParallelAssembler
+{
+public :
+
+	// threadCount includes the calling thread
+	ParallelAssembler(u32 threadCount = ThreadPool::getProcessorCount());
+
+	// Adds a directory where files included by assembled files are searched
+	void addIncludePath(const std::string & dir);
+
+	// Assembles a preprocessed program into object.
+	// If relocatable is false, using a label that is not defined is an
+	// error, and the object has no import. Otherwise it is an import.
+	// fileNames are the files tokens come from, named in errors
+	// (see Assembler::setFileNames).
+	// Returns false if an error occurred.
+	bool assembleTokens(const std::vector<Token> & tokens,
+		ObjectFile & object, bool relocatable,
+		const std::vector<std::string> * fileNames = 0);
+
+	// Preprocesses and assembles files into objects (in the same order).
+	// Files they include are read once for all (see SourceCache).
+	// Returns false if an error occurred in any of them.
+	bool assembleFiles(const std::vector<std::string> & filenames,
+		std::vector<ObjectFile> & objects);
+
+	const std::string & getExceptionString() const
+	{ return m_exceptionString; }
+
+	bool isException() const
+	{ return !m_exceptionString.empty(); }
+
+private :
+
+	class ChunkTask;
+	class FileTask;
+
+	// Preprocesses and assembles a file into a relocatable object.
+	// Included files are read through sources.
+	// If split is true, it may be split into chunks (then this
+	// must be called from the thread that owns the ParallelAssembler).
+	// Returns false and sets error if an error occurred.
+	bool assembleFile(const std::string & filename, SourceCache & sources,
+		ObjectFile & object, std::string & error, bool split);
+
+	// Places assembled chunks one after the other into object,
+	// and writes the addresses of labels used across chunks
+	bool mergeChunks(const ChunkTask & task,
+		ObjectFile & object, bool relocatable,
+		const std::vector<std::string> * fileNames);
+
+	ThreadPool m_pool;
+	std::vector<std::string> m_includePaths;
+	std::string m_exceptionString;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_PARALLELASSEMBLER_HPP_INCLUDED
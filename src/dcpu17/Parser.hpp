@@ -4,23 +4,25 @@
 #include <iostream>
 #include <string>
 
+#include "Lexer.hpp"
 #include "ParserStream.hpp"
 
 namespace dcpu
 {
 
 //
-// Parser
+// Parser: reads tokens from a Lexer.
+// Comments are skipped like whitespace.
 //
 class Parser
 {
 public :
 
 	// Constructs a Parser.
+	// The stream is read at once by the ParserStream, then split into tokens.
 	// is should be a binary stream, and not be modified externally
 	// while the Parser is used.
-	Parser(std::istream & is) : m_is(is)
-	{}
+	Parser(std::istream & is);
 
 	// Access to the stream
 	ParserStream & stream() { return m_is; }
@@ -29,17 +31,26 @@ public :
 	bool isException() const { return !m_exceptionString.empty(); }
 	const std::string & getExceptionString() const { return m_exceptionString; }
 
-	// Returns false if the next char is an end of line / end of stream.
+	// Current token
+	const Token & token() const { return m_token; }
+
+	// Offset of the current token in the source
+	u32 tell() const { return m_token.text - m_is.data(); }
+
+	// Goes to the next token
+	void next();
+
+	// Returns false if the current token is an end of line / end of stream.
 	// If so, an exception is also set.
 	bool checkNoEndOfLine();
 
-	// Each or the methods below advance m_is cursor,
+	// Each or the methods below advance the current token,
 	// return false if an error occurred and set the exceptionString if so.
 	// The result of other parsing operations after an exception is undetermined.
-	// Functions beginning by 'parse' expect the stream to be
-	// positionned at the beginning of the expected sequence.
+	// Functions beginning by 'parse' expect the current token to be
+	// the expected one.
 
-	// SKips whitespace until reach non-whitespace or end of line.
+	// Whitespace is skipped by the lexer, this only checks the end of line.
 	// Returns false if reached end of current line.
 	// If endOfLineNotExpected is true, an exception will be set if
 	// the end of line is reached.
@@ -53,17 +64,11 @@ public :
 	// Returns false if end of stream.
 	bool nextLine();
 
-	// Parses a 16-bit integer using one of the two functions below
+	// Parses a 16-bit integer (123 or 0x7b)
 	bool parseU16(u16 & value);
 
-	// Parses a 16-bit integer written in decimal form (123456789)
-	bool parseDecU16(u16 & value);
-
-	// Parses a 16-bit integer written in hexadecimal form (123456789abcdef)
-	bool parseHexU16(u16 & value);
-
-	// Parses a string written between two sep characters.
-	bool parseString(std::string & str, char sep = '"');
+	// Parses a string written between quotes.
+	bool parseString(std::string & str);
 
 	// Parses a set of characters included in a-zA-Z_0-9.
 	// Param what is the type of name (for debug).
@@ -79,33 +84,15 @@ protected :
 	// Parsed stream
 	ParserStream m_is;
 
+	Lexer m_lexer;
+	Token m_token;
+
 	// Parsing error message (C++ exceptions are not used)
 	std::string m_exceptionString;
 
 };
 
-//
-// Character sets
-//
-
-// Defines whitespace characters
-inline bool isWhiteSpace(char c)
-{
-	return c == ' ' || c == '\t';
-}
-
-// Defines litteral characters (used for names)
-inline bool isLitteral(char c)
-{
-	return (c >= 'a' && c <= 'z')
-		|| (c >= 'A' && c <= 'Z')
-		|| c == '_';
-}
-
 } // namespace dcpu
 
 #endif // HEADER_PARSER_HPP_INCLUDED
 
-
-
-
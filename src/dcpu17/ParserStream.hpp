@@ -2,69 +2,43 @@
 #define PARSERSTREAM_HPP_INCLUDED
 
 #include <iostream>
-#include <fstream>
+#include <vector>
 #include "common.hpp"
 
 namespace dcpu
 {
-// Defines end-of-line chars
-inline bool isEndOfLine(char c)
-{
-	return c == '\n' || c == '\r';
-}
 
 //
-// This is a std::istream wrapper that can count line pos and number.
+// Source text of a parser, held in memory.
+// The std::istream is read once when the ParserStream is constructed,
+// then positions are plain offsets in the buffer.
 //
 
 class ParserStream
 {
 private :
 
-	std::istream & r_is; // Parsed stream
-	char m_lastChar; // Last read char
-	u32 m_col; // line pos
-	u32 m_row; // line number
+	std::vector<char> m_data; // Content of the stream
+	bool m_good; // False if the stream couldn't be read
 
 public :
 
 	// Constructs a ParserStream.
-	// is should be a binary stream, and not be modified externally
-	// while the ParserStream is used.
-	ParserStream(std::istream & is) : r_is(is)
-	{
-		m_col = 0;
-		m_row = 0;
-		m_lastChar = 0;
-	}
+	// is should be a binary stream. It is read until its end.
+	ParserStream(std::istream & is);
 
 	// Accessors
 
-	u32 getCol() const { return m_col; }
-	u32 getRow() const { return m_row; }
-	char getLastChar() const {return m_lastChar; }
-
-	// Puts read characters into os, starting from startPos to endPos.
-	// Does nothing if pos >= tellg().
-	// if endPos > tellg(), it is changed to tellg().
-	void getReadData(
-		std::ostream & os,
-		std::streampos startPos,
-		std::streampos endPos);
-
-	// istream wrapper methods
-
-	// Same as istream::peek
-	char peek() const { return r_is.peek(); }
+	bool good() const { return m_good; }
+	const char * data() const { return m_data.empty() ? 0 : &m_data[0]; }
+	u32 size() const { return m_data.size(); }
 
-	// Same as istream::get, also count newlines and line pos.
-	char get();
+	// Exchanges the content with data (so it can outlive the stream)
+	void swap(std::vector<char> & data) { m_data.swap(data); }
 
-	// Same as istream::eof
-	bool eof() const { return r_is.eof(); }
-
-	// Same ase istream::tellg
-	std::streampos tellg() const { return r_is.tellg(); }
+	// Puts characters into os, from startPos to endPos (excluded).
+	// endPos is clamped to size().
+	void getReadData(std::ostream & os, u32 startPos, u32 endPos) const;
 
 };
 
@@ -72,5 +46,3 @@ public :
 
 #endif // PARSERSTREAM_HPP_INCLUDED
 
-
-
@@ -2,22 +2,97 @@
 #include <sstream>
 
 #include "Preprocessor.hpp"
+#include "utility.hpp"
 
 namespace dcpu
 {
-bool Preprocessor::process()
+const std::string * SourceCache::get(const std::string & path)
+{
+	sf::Lock lock(m_mutex);
+
+	std::map<std::string, std::string>::iterator it = m_files.find(path);
+	if(it == m_files.end())
+	{
+		std::ifstream ifs(path.c_str(), std::ios::in|std::ios::binary);
+		std::vector<char> data;
+		if(!ifs.good() || !readStream(ifs, data))
+			return 0;
+		it = m_files.insert(std::make_pair(path, std::string(data.begin(), data.end()))).first;
+	}
+
+	// Note: std::map references stay valid when other files are added
+	return &it->second;
+}
+
+Preprocessor::Preprocessor(std::istream & is, const std::string & fileName)
+	: Parser(is), r_os(0), r_tokens(0), m_readCharsStartPos(0), m_containsOnce(false),
+	m_errorInInclude(false), m_fileIndex(0), r_context(m_context)
+{
+	// Knowing the file allows to find files relative to it,
+	// and to detect it includes itself
+	if(!fileName.empty())
+		getCanonicalPath(fileName, m_path);
+	r_context.fileNames.push_back(m_path);
+}
+
+Preprocessor::Preprocessor(std::istream & is, const std::string & path,
+	u16 fileIndex, PreprocessorContext & context)
+	: Parser(is), r_os(0), r_tokens(0), m_readCharsStartPos(0), m_containsOnce(false),
+	m_errorInInclude(false), m_path(path), m_fileIndex(fileIndex), r_context(context)
+{}
+
+void Preprocessor::addIncludePath(const std::string & dir)
+{
+	r_context.includePaths.push_back(dir);
+}
+
+bool Preprocessor::process(std::ostream & os)
+{
+	std::cout << "Preprocessing..." << std::endl;
+
+	r_os = &os;
+	r_tokens = 0;
+	if(!processStream())
+		return false;
+
+	std::cout << "Preprocessing finished." << std::endl;
+	return true;
+}
+
+bool Preprocessor::process(std::vector<Token> & tokens)
 {
 	std::cout << "Preprocessing..." << std::endl;
 
+	r_os = 0;
+	r_tokens = &tokens;
+	if(!processStream())
+		return false;
+
+	// The assembler expects the end of the source
+	Token end = token();
+	end.type = TOKEN_END;
+	end.size = 0;
+	tokens.push_back(end);
+
+	std::cout << "Preprocessing finished." << std::endl;
+	return true;
+}
+
+bool Preprocessor::processStream()
+{
+	if(isException())
+		return false;
+
+	if(!m_path.empty())
+		r_context.includeStack.push_back(m_path);
+
 	while(skipWhiteSpaceAndEmptyLines())
 	{
-		std::streampos posBeforeCommand = stream().tellg();
-
-		if(stream().get() == '#')
+		if(token().type == TOKEN_DIRECTIVE)
 		{
-			std::string cmd;
-			if(!parseName(cmd, "preprocessor command"))
-				return false;
+			const u32 posBeforeCommand = tell();
+			const std::string cmd = token().toString();
+			next();
 
 			// Write previously read characters to output
 			outputReadChars(posBeforeCommand);
@@ -33,8 +108,10 @@ bool Preprocessor::process()
 			// Set cursor just after the command, then at the next
 			// call to outputReadChar the command will not be written to
 			// the output.
-			m_readCharsStartPos = stream().tellg();
+			m_readCharsStartPos = tell();
 		}
+		else if(!processLine())
+			return false;
 
 #ifdef DCPU_DEBUG
 		std::cout << "Preprocessor: nextline..." << std::endl;
@@ -43,8 +120,181 @@ bool Preprocessor::process()
 		nextLine();
 	}
 
-	outputReadChars(stream().tellg());
-	std::cout << "Preprocessing finished." << std::endl;
+	outputReadChars(stream().size());
+
+	if(!m_path.empty())
+		r_context.includeStack.pop_back();
+
+	return true;
+}
+
+bool Preprocessor::processLine()
+{
+	m_line.clear();
+	while(!token().isEndOfLine())
+	{
+		m_line.push_back(token());
+		next();
+	}
+
+	m_expansion.clear();
+	bool expanded = false;
+	if(!expand(&m_line[0], m_line.size(), m_expansion, expanded))
+		return false;
+
+	if(r_tokens != 0)
+	{
+		// Errors found later tell which file tokens come from
+		// (including those of macros, located at the call)
+		for(u32 i = 0; i < m_expansion.size(); ++i)
+			m_expansion[i].file = m_fileIndex;
+		r_tokens->insert(r_tokens->end(), m_expansion.begin(), m_expansion.end());
+
+		// The last line of the source may end with TOKEN_END
+		Token eol = token();
+		eol.type = TOKEN_END_OF_LINE;
+		eol.file = m_fileIndex;
+		r_tokens->push_back(eol);
+	}
+	else if(expanded)
+	{
+		// Lines without macros are copied as they are.
+		// Others are rewritten from the first to the last token
+		// (indentation and comments are kept).
+		const Token & last = m_line.back();
+		outputReadChars(m_line[0].text - stream().data());
+		if(!m_expansion.empty())
+			*r_os << tokensToString(&m_expansion[0], m_expansion.size());
+		m_readCharsStartPos = last.text + last.size - stream().data();
+	}
+
+	return true;
+}
+
+bool Preprocessor::expand(const Token * tokens, u32 count,
+	std::vector<Token> & out, bool & expanded)
+{
+	for(u32 i = 0; i < count; ++i)
+	{
+		const Token & t = tokens[i];
+
+		u32 id = DCPU_SYMBOL_NONE;
+		if(t.type == TOKEN_NAME)
+			id = r_context.macroNames.find(t.text, t.size);
+
+		if(id == DCPU_SYMBOL_NONE
+			|| !r_context.macros[id].defined
+			|| r_context.macros[id].expanding)
+		{
+			out.push_back(t);
+			continue;
+		}
+
+		// Note: no macro is defined during an expansion,
+		// so references to macros stay valid
+		Macro & macro = r_context.macros[id];
+
+		// A function-like macro without arguments is a plain name
+		if(macro.functionLike && (i + 1 == count || !tokens[i+1].isPunctuation('(')))
+		{
+			out.push_back(t);
+			continue;
+		}
+
+		std::vector<Token> body;
+
+		if(macro.functionLike)
+		{
+			// Split arguments on commas outside of parenthesis
+			std::vector<std::vector<Token> > args(1);
+			u32 depth = 0;
+			u32 j = i + 2;
+			for(; j < count; ++j)
+			{
+				const Token & a = tokens[j];
+				if(a.isPunctuation(')'))
+				{
+					if(depth == 0)
+						break;
+					--depth;
+				}
+				else if(a.isPunctuation('('))
+					++depth;
+				else if(a.isPunctuation(',') && depth == 0)
+				{
+					args.push_back(std::vector<Token>());
+					continue;
+				}
+				args.back().push_back(a);
+			}
+
+			if(j == count)
+			{
+				std::stringstream ss;
+				ss << "Macro " << t.toString() << ": missing ')'";
+				setException(ss.str());
+				return false;
+			}
+
+			// NAME() has one empty argument, which means none
+			if(macro.paramCount == 0 && args.size() == 1 && args[0].empty())
+				args.clear();
+
+			if(args.size() != macro.paramCount)
+			{
+				std::stringstream ss;
+				ss << "Macro " << t.toString() << ": expected "
+					<< macro.paramCount << " argument(s), got " << args.size();
+				setException(ss.str());
+				return false;
+			}
+
+			// Arguments are expanded before being substituted
+			std::vector<std::vector<Token> > expandedArgs(args.size());
+			for(u32 a = 0; a < args.size(); ++a)
+			{
+				bool argExpanded = false;
+				if(!args[a].empty() && !expand(&args[a][0], args[a].size(),
+					expandedArgs[a], argExpanded))
+					return false;
+			}
+
+			for(u32 b = 0; b < macro.body.size(); ++b)
+			{
+				const Token & bt = macro.body[b];
+				if(bt.type == TOKEN_NAME && bt.value != 0)
+				{
+					const std::vector<Token> & arg = expandedArgs[bt.value - 1];
+					body.insert(body.end(), arg.begin(), arg.end());
+				}
+				else
+					body.push_back(bt);
+			}
+
+			i = j;
+		}
+		else
+			body = macro.body;
+
+		// Errors in the result refer to the macro call
+		for(u32 b = 0; b < body.size(); ++b)
+		{
+			body[b].row = t.row;
+			body[b].col = t.col;
+			if(body[b].type == TOKEN_NAME)
+				body[b].value = 0;
+		}
+
+		// Rescan the result, without expanding the macro again
+		macro.expanding = true;
+		const bool res = body.empty() || expand(&body[0], body.size(), out, expanded);
+		macro.expanding = false;
+		if(!res)
+			return false;
+
+		expanded = true;
+	}
+
 	return true;
 }
 
@@ -55,19 +305,31 @@ int Preprocessor::processCommand(const std::string & cmd)
 		if(!processInclude())
 			return -2;
 	}
+	else if(cmd == "pragma")
+	{
+		if(!processPragma())
+			return -2;
+	}
 	else if(cmd == "define")
 	{
 		if(!processDefine())
 			return -2;
 	}
+	else if(cmd == "undef")
+	{
+		if(!processUndef())
+			return -2;
+	}
 	else
 		return -1;
 	return 0;
 }
 
-void Preprocessor::outputReadChars(std::streampos endPos)
+void Preprocessor::outputReadChars(u32 endPos)
 {
-	stream().getReadData(r_os, m_readCharsStartPos, endPos);
+	// Token output only takes lines, not characters
+	if(r_os != 0)
+		stream().getReadData(*r_os, m_readCharsStartPos, endPos);
 }
 
 bool Preprocessor::processInclude()
@@ -80,46 +342,262 @@ bool Preprocessor::processInclude()
 		return false;
 
 	std::string filename;
-	if(!parseString(filename, '"'))
+	if(!parseString(filename))
 		return false;
 
-	std::ifstream ifs(filename.c_str(),
-		std::ios::in|std::ios::binary);
-	if(!ifs.good())
+	std::string path;
+	if(!findIncludedFile(filename, path))
 	{
 		std::stringstream ss;
-		ss << "#include \"" << filename << "\": " << "couldn't open file";
+		ss << "#include \"" << filename << "\": " << "couldn't find file";
 		setException(ss.str());
-		ifs.close();
 		return false;
 	}
 
-	// TODO Preprocessor: recursive #include command
-	// Currently one-level
-	// Write file content to output
-	char c = 0;
-	while(!ifs.eof())
+	IncludedFile & file = r_context.files[path];
+
+	// Also skips a file including itself, which is not a cycle then
+	if(file.pragmaOnce)
+	{
+#ifdef DCPU_DEBUG
+		std::cout << "Skipping " << path << " (#pragma once)" << std::endl;
+#endif
+		return true;
+	}
+
+	// Cycle detection
+	for(u32 i = 0; i < r_context.includeStack.size(); ++i)
+	{
+		if(r_context.includeStack[i] == path)
+		{
+			std::stringstream ss;
+			ss << "#include \"" << filename << "\": " << "the file includes itself (";
+			for(u32 j = i; j < r_context.includeStack.size(); ++j)
+				ss << r_context.includeStack[j] << " -> ";
+			ss << path << ")";
+			setException(ss.str());
+			return false;
+		}
+	}
+
+	if(file.index == 0 && path != r_context.fileNames[0])
+	{
+		file.index = r_context.fileNames.size();
+		r_context.fileNames.push_back(path);
+	}
+
+	// The output of a file depends on the macros defined before it.
+	// It can't be used again either if it contains a file with
+	// #pragma once, which must not appear twice.
+	if(!file.preprocessed || file.macroGeneration != r_context.macroGeneration
+		|| file.containsOnce)
 	{
-		c = ifs.get();
-		if(!ifs.eof())
-			r_os.put(c);
+		std::ifstream ifs;
+		std::istringstream shared;
+		std::istream * is = &shared;
+		const std::string * content = 0;
+		if(r_context.sourceCache != 0)
+			content = r_context.sourceCache->get(path);
+		if(content != 0)
+			shared.str(*content);
+		else
+		{
+			ifs.open(path.c_str(), std::ios::in|std::ios::binary);
+			if(!ifs.good())
+			{
+				std::stringstream ss;
+				ss << "#include \"" << filename << "\": " << "couldn't open file";
+				setException(ss.str());
+				return false;
+			}
+			is = &ifs;
+		}
+
+		const u32 generation = r_context.macroGeneration;
+		std::stringstream output;
+		Preprocessor preprocessor(*is, path, file.index, r_context);
+		file.tokens.clear();
+		if(r_tokens != 0)
+			preprocessor.r_tokens = &file.tokens;
+		else
+			preprocessor.r_os = &output;
+
+		if(!preprocessor.processStream())
+		{
+			// The message is located in the file the error is in
+			// (errors from deeper files already name theirs)
+			if(preprocessor.m_errorInInclude)
+				m_exceptionString = preprocessor.getExceptionString();
+			else
+				m_exceptionString = path + ": " + preprocessor.getExceptionString();
+			m_errorInInclude = true;
+			return false;
+		}
+
+		// Macros and tokens point into the source of the file
+		r_context.sources.push_back(std::vector<char>());
+		preprocessor.stream().swap(r_context.sources.back());
+
+		// Note: std::map references stay valid when other files are added.
+		// If the file defines macros, the generation changed and
+		// it will be preprocessed again if included again.
+		file.output = output.str();
+		file.preprocessed = true;
+		file.containsOnce = preprocessor.m_containsOnce;
+		file.macroGeneration = generation;
 	}
 
-	ifs.close();
+	if(file.pragmaOnce || file.containsOnce)
+		m_containsOnce = true;
+
+	if(r_tokens != 0)
+		r_tokens->insert(r_tokens->end(), file.tokens.begin(), file.tokens.end());
+	else
+		*r_os << file.output;
 	return true;
 }
 
+bool Preprocessor::processPragma()
+{
+	if(!skipWhiteSpace(true))
+		return false;
+
+	std::string name;
+	if(!parseName(name, "pragma"))
+		return false;
+
+	if(name == "once")
+	{
+		if(!m_path.empty())
+			r_context.files[m_path].pragmaOnce = true;
+		return true;
+	}
+
+	// Unknown pragmas are ignored, as other preprocessors do
+	std::cout << "I: Preprocessor: ignored #pragma " << name << std::endl;
+	return true;
+}
+
+bool Preprocessor::findIncludedFile(const std::string & name, std::string & path) const
+{
+	// Directory of the including file
+	if(!m_path.empty() && getCanonicalPath(getDirectory(m_path) + name, path))
+		return true;
+
+	for(u32 i = 0; i < r_context.includePaths.size(); ++i)
+	{
+		std::string dir = r_context.includePaths[i];
+		if(!dir.empty() && dir[dir.size() - 1] != '/' && dir[dir.size() - 1] != DIR_CHAR)
+			dir += DIR_CHAR;
+		if(getCanonicalPath(dir + name, path))
+			return true;
+	}
+
+	// Working directory
+	return getCanonicalPath(name, path);
+}
+
 bool Preprocessor::processDefine()
 {
 #ifdef DCPU_DEBUG
-	std::cout << "Found #define" << std::endl;
+	std::cout << "Processing #define..." << std::endl;
 #endif
 
-	// TODO Preprocessor: processDefine
-	setException("Not implemented yet");
-	return false;
+	if(!skipWhiteSpace(true))
+		return false;
+
+	const Token nameToken = token();
+	std::string name;
+	if(!parseName(name, "macro name"))
+		return false;
+
+	Macro macro;
+	macro.defined = true;
+
+	// Parameters, if '(' follows the name without space
+	std::vector<std::string> params;
+	if(token().isPunctuation('(') && token().text == nameToken.text + nameToken.size)
+	{
+		macro.functionLike = true;
+		next();
+		if(!token().isPunctuation(')'))
+		{
+			while(true)
+			{
+				std::string param;
+				if(!parseName(param, "macro parameter"))
+					return false;
+				for(u32 i = 0; i < params.size(); ++i)
+				{
+					if(params[i] == param)
+					{
+						setException("Duplicate macro parameter '" + param + "'");
+						return false;
+					}
+				}
+				params.push_back(param);
+
+				if(token().isPunctuation(')'))
+					break;
+				if(!token().isPunctuation(','))
+				{
+					if(checkNoEndOfLine())
+						setException("Expected ',' or ')' in macro parameters");
+					return false;
+				}
+				next();
+			}
+		}
+		next();
+		macro.paramCount = params.size();
+	}
+
+	// Body: the rest of the line
+	while(!token().isEndOfLine())
+	{
+		Token t = token();
+		if(t.type == TOKEN_NAME)
+		{
+			t.value = 0;
+			for(u32 i = 0; i < params.size(); ++i)
+			{
+				if(params[i].size() == t.size && params[i].compare(0, t.size, t.text, t.size) == 0)
+				{
+					t.value = i + 1;
+					break;
+				}
+			}
+		}
+		macro.body.push_back(t);
+		next();
+	}
+
+	const u32 id = r_context.macroNames.intern(name);
+	if(id >= r_context.macros.size())
+		r_context.macros.resize(id + 1);
+	r_context.macros[id] = macro;
+	++r_context.macroGeneration;
+	return true;
 }
 
-} // namespace dcpu
+bool Preprocessor::processUndef()
+{
+	if(!skipWhiteSpace(true))
+		return false;
 
+	std::string name;
+	if(!parseName(name, "macro name"))
+		return false;
+
+	// Undefining an unknown name is not an error
+	const u32 id = r_context.macroNames.find(name.c_str(), name.size());
+	if(id != DCPU_SYMBOL_NONE && id < r_context.macros.size())
+	{
+		r_context.macros[id].defined = false;
+		++r_context.macroGeneration;
+	}
+	return true;
+}
+
+} // namespace dcpu
 
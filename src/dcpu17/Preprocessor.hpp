@@ -2,34 +2,171 @@
 #define HEADER_PREPROCESSOR_HPP_INCLUDED
 
 #include <iostream>
+#include <list>
+#include <map>
+#include <vector>
+#include <SFML/System.hpp>
 #include "Parser.hpp"
+#include "SymbolTable.hpp"
 
 namespace dcpu
 {
+// A file included during a preprocessing run
+struct IncludedFile
+{
+	std::string output; // Preprocessed content (text output)
+	std::vector<Token> tokens; // Preprocessed content (token output)
+	bool preprocessed; // The output is complete
+	bool pragmaOnce; // The file contains #pragma once
+	bool containsOnce; // The output contains a file with #pragma once
+	u32 macroGeneration; // Macro generation after it was preprocessed
+	u16 index; // Index in PreprocessorContext::fileNames
+
+	IncludedFile() : preprocessed(false), pragmaOnce(false), containsOnce(false),
+		macroGeneration(0), index(0)
+	{}
+};
+
+/*
+	Content of included files, shared by several preprocessing runs
+	(such as the modules of a program assembled in parallel), so each
+	file is read from the disk once. Each run still preprocesses it,
+	because the macros defined before it may differ.
+	It can be used by several threads at the same time.
+*/
+class SourceCache
+{
+public :
+
+	// Gets the content of a file, reading it the first time.
+	// Returns null if it couldn't be read.
+	// The content stays valid while the cache exists.
+	const std::string * get(const std::string & path);
+
+private :
+
+	sf::Mutex m_mutex;
+	std::map<std::string, std::string> m_files; // By canonical path
+};
+
+// A #define
+struct Macro
+{
+	// Replacement tokens. The value of a name that is a parameter
+	// is the index of the parameter + 1 (0 for other names).
+	std::vector<Token> body;
+	u32 paramCount;
+	bool functionLike; // NAME(params) body
+	bool defined; // false if undefined with #undef
+	bool expanding; // Guard against recursive expansion
+
+	Macro() : paramCount(0), functionLike(false), defined(false), expanding(false)
+	{}
+};
+
+// State shared by a preprocessor and the ones of the files it includes
+struct PreprocessorContext
+{
+	// Directories where included files are searched
+	std::vector<std::string> includePaths;
+
+	// Files met so far, by canonical path.
+	// Each file is read and preprocessed once per run.
+	std::map<std::string, IncludedFile> files;
+
+	// Canonical paths of the files being preprocessed, outermost first
+	std::vector<std::string> includeStack;
+
+	// Paths of the files output tokens come from, indexed by Token::file.
+	// The first one is the preprocessed file (empty for a stream).
+	std::vector<std::string> fileNames;
+
+	// Content of the included files. Macros and output tokens
+	// point into them, so they are kept until the end of the run.
+	std::list<std::vector<char> > sources;
+
+	// Macros, indexed by the ID of their name
+	SymbolTable macroNames;
+	std::vector<Macro> macros;
+
+	// Incremented each time a macro is defined or undefined
+	u32 macroGeneration;
+
+	// Shared with other runs, null if files are read by this one
+	SourceCache * sourceCache;
+
+	PreprocessorContext() : macroGeneration(0), sourceCache(0)
+	{}
+};
+
 /*
 	Generic preprocessor.
 	should be subclassed for adding more DASM-specific commands.
+
+	#include "file" inserts the preprocessed content of a file.
+	The file is searched in the directory of the including file,
+	then in the include paths, then in the working directory.
+	A file containing #pragma once is inserted only the first time.
+	Including a file from itself (even indirectly) is an error.
+
+	#define NAME tokens
+	#define NAME(a, b) tokens using a and b
+	#undef NAME
+	Macros are expanded token by token in the lines that follow.
+	The result of an expansion is expanded again, except for the macros
+	being expanded (so a macro can't expand into itself forever).
+
+	The output is either text (lines without macros are copied as is),
+	or tokens that can be given to Assembler::assembleTokens.
 */
 
 class Preprocessor : public Parser
 {
 private :
 
-	std::ostream & r_os;
-	std::streampos m_readCharsStartPos;
+	std::ostream * r_os; // Text output
+	std::vector<Token> * r_tokens; // Token output
+	u32 m_readCharsStartPos; // Offset of the first character not output yet
+	bool m_containsOnce; // The output contains a file with #pragma once
+	bool m_errorInInclude; // The error occurred in an included file
+
+	std::string m_path; // Canonical path of the file, empty for a stream
+	u16 m_fileIndex; // Index of the file in the context
+	PreprocessorContext m_context;
+	PreprocessorContext & r_context; // Shared with included files
+
+	std::vector<Token> m_line; // Tokens of the current line
+	std::vector<Token> m_expansion; // Same, with macros expanded
 
 public :
 
-	Preprocessor(std::istream & is, std::ostream & os)
-		: Parser(is), r_os(os)
-	{
-		m_readCharsStartPos = 0;
-	}
+	// Constructs a preprocessor reading is.
+	// If the stream is a file, fileName is used to find included files.
+	Preprocessor(std::istream & is, const std::string & fileName = "");
+
+	// Adds a directory where included files are searched
+	void addIncludePath(const std::string & dir);
+
+	// Reads included files through a cache shared with other runs
+	void setSourceCache(SourceCache & cache) { r_context.sourceCache = &cache; }
 
 	// Processes #commands from the input stream and
-	// put the resulting stream in r_os.
+	// put the resulting stream in os.
 	// Returns false if an error occurred.
-	bool process();
+	bool process(std::ostream & os);
+
+	// Same as above, with tokens as output. The last token is TOKEN_END.
+	// Tokens point into the sources of the preprocessor, so they are
+	// valid until it is destroyed.
+	bool process(std::vector<Token> & tokens);
+
+	// Files included so far, by canonical path
+	const std::map<std::string, IncludedFile> & getIncludedFiles() const
+	{ return r_context.files; }
+
+	// Paths of the files output tokens come from, indexed by Token::file
+	const std::vector<std::string> & getFileNames() const
+	{ return r_context.fileNames; }
 
 protected :
 
@@ -41,10 +178,34 @@ protected :
 
 private :
 
-	void outputReadChars(std::streampos endPos);
+	// Constructs the preprocessor of an included file
+	Preprocessor(std::istream & is, const std::string & path, u16 fileIndex,
+		PreprocessorContext & context);
+
+	bool isIncluded() const { return &r_context != &m_context; }
+
+	// Processes the whole stream (output is r_os or r_tokens)
+	bool processStream();
+
+	// Outputs the current line, with macros expanded
+	bool processLine();
+
+	// Appends tokens to out, with macros expanded.
+	// Sets expanded to true if there was a macro.
+	bool expand(const Token * tokens, u32 count,
+		std::vector<Token> & out, bool & expanded);
+
+	// Writes the source from m_readCharsStartPos to endPos to the output
+	void outputReadChars(u32 endPos);
+
+	// Finds the file an #include refers to.
+	// Returns false if it doesn't exist.
+	bool findIncludedFile(const std::string & name, std::string & path) const;
 
 	bool processInclude();
+	bool processPragma();
 	bool processDefine();
+	bool processUndef();
 
 };
 
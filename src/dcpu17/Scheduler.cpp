@@ -0,0 +1,75 @@
+#include <algorithm>
+#include "Scheduler.hpp"
+
+namespace dcpu
+{
+void Scheduler::schedule(IScheduled * target, u32 cycle, u16 id)
+{
+	Event e;
+	e.cycle = cycle;
+	e.order = m_order++;
+	e.target = target;
+	e.id = id;
+
+	m_events.push_back(e);
+	std::push_heap(m_events.begin(), m_events.end(), Later());
+}
+
+void Scheduler::cancel(IScheduled * target)
+{
+	u32 n = 0;
+	for(u32 i = 0; i < m_events.size(); ++i)
+	{
+		if(m_events[i].target != target)
+			m_events[n++] = m_events[i];
+	}
+	if(n == m_events.size())
+		return;
+	m_events.resize(n);
+	std::make_heap(m_events.begin(), m_events.end(), Later());
+}
+
+void Scheduler::cancel(IScheduled * target, u16 id)
+{
+	u32 n = 0;
+	for(u32 i = 0; i < m_events.size(); ++i)
+	{
+		if(m_events[i].target != target || m_events[i].id != id)
+			m_events[n++] = m_events[i];
+	}
+	if(n == m_events.size())
+		return;
+	m_events.resize(n);
+	std::make_heap(m_events.begin(), m_events.end(), Later());
+}
+
+void Scheduler::clear()
+{
+	m_events.clear();
+}
+
+bool Scheduler::isScheduled(const IScheduled * target, u16 id) const
+{
+	for(u32 i = 0; i < m_events.size(); ++i)
+	{
+		if(m_events[i].target == target && m_events[i].id == id)
+			return true;
+	}
+	return false;
+}
+
+void Scheduler::run(u32 now)
+{
+	while(isDue(now))
+	{
+		// Pop before calling, the target may schedule or cancel events
+		const Event e = m_events.front();
+		std::pop_heap(m_events.begin(), m_events.end(), Later());
+		m_events.pop_back();
+
+		e.target->onScheduledEvent(e.id, e.cycle);
+	}
+}
+
+} // namespace dcpu
+
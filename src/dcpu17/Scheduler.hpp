@@ -0,0 +1,105 @@
+#ifndef HEADER_DCPU_SCHEDULER_HPP_INCLUDED
+#define HEADER_DCPU_SCHEDULER_HPP_INCLUDED
+
+#include <vector>
+#include "common.hpp"
+
+namespace dcpu
+{
+// Something that can be woken up at a given DCPU cycle
+class IScheduled
+{
+public :
+
+	virtual ~IScheduled() {}
+
+	// Called when a scheduled event is due.
+	// id is the value given to Scheduler::schedule(),
+	// cycle is the deadline the event was scheduled for
+	// (the current cycle count can be a bit further).
+	virtual void onScheduledEvent(u16 id, u32 cycle) = 0;
+};
+
+// Returns true if cycle a comes after cycle b.
+// Cycle counters may wrap around, compared cycles must be less than
+// 2^31 cycles away from each other.
+// Note: u32 is not always 32-bit, hence the explicit mask.
+inline bool isCycleAfter(u32 a, u32 b)
+{
+	const u32 d = (a - b) & 0xffffffff;
+	return d != 0 && d < 0x80000000;
+}
+
+//
+// Keeps events ordered by their deadline in DCPU cycles.
+// Events are run by the DCPU itself, so their timing only depends
+// on guest time, not on the host's framerate.
+//
+class Scheduler
+{
+public :
+
+	Scheduler()
+	{
+		m_order = 0;
+	}
+
+	// Schedules an event for target at the given cycle
+	void schedule(IScheduled * target, u32 cycle, u16 id = 0);
+
+	// Removes all events scheduled for target
+	void cancel(IScheduled * target);
+
+	// Removes the events scheduled for target with the given id
+	void cancel(IScheduled * target, u16 id);
+
+	// Removes all events
+	void clear();
+
+	// Returns true if an event is scheduled for target with the given id
+	bool isScheduled(const IScheduled * target, u16 id) const;
+
+	bool empty() const { return m_events.empty(); }
+
+	// Cycle of the next event. Must not be called if empty().
+	u32 getNextDeadline() const { return m_events.front().cycle; }
+
+	// Returns true if an event must be run at cycle now
+	bool isDue(u32 now) const
+	{
+		return !m_events.empty() && !isCycleAfter(m_events.front().cycle, now);
+	}
+
+	// Runs all events which deadline is reached at cycle now.
+	// Events scheduled from a callback are run in the same call if they are due.
+	void run(u32 now);
+
+private :
+
+	struct Event
+	{
+		u32 cycle;
+		u32 order; // Keeps scheduling order for equal deadlines
+		IScheduled * target;
+		u16 id;
+	};
+
+	// Heap ordering (the first event is the earliest)
+	struct Later
+	{
+		bool operator()(const Event & a, const Event & b) const
+		{
+			if(a.cycle != b.cycle)
+				return isCycleAfter(a.cycle, b.cycle);
+			return isCycleAfter(a.order, b.order);
+		}
+	};
+
+	std::vector<Event> m_events; // Binary heap
+	u32 m_order;
+
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_SCHEDULER_HPP_INCLUDED
@@ -0,0 +1,101 @@
+#include <cstring>
+#include "SymbolTable.hpp"
+
+// Initial hash table size (must be a power of two)
+#define DCPU_SYMBOL_TABLE_MIN_SLOTS 256
+
+namespace dcpu
+{
+
+SymbolTable::SymbolTable()
+{
+	clear();
+}
+
+void SymbolTable::clear()
+{
+	m_names.clear();
+	m_symbols.clear();
+	m_slots.assign(DCPU_SYMBOL_TABLE_MIN_SLOTS, 0);
+}
+
+u32 SymbolTable::hash(const char * name, u32 size)
+{
+	// FNV-1a
+	u32 h = 2166136261u;
+	for(u32 i = 0; i < size; ++i)
+	{
+		h ^= static_cast<u8>(name[i]);
+		h = (h * 16777619u) & 0xffffffff;
+	}
+	return h;
+}
+
+u32 SymbolTable::findSlot(const char * name, u32 size, u32 h) const
+{
+	const u32 mask = m_slots.size() - 1;
+	for(u32 slot = h & mask; ; slot = (slot + 1) & mask)
+	{
+		const u32 id1 = m_slots[slot];
+		if(id1 == 0)
+			return slot;
+
+		const Symbol & s = m_symbols[id1 - 1];
+		if(s.hash == h && s.size == size
+			&& std::memcmp(&m_names[s.offset], name, size) == 0)
+			return slot;
+	}
+}
+
+u32 SymbolTable::find(const char * name, u32 size) const
+{
+	const u32 id1 = m_slots[findSlot(name, size, hash(name, size))];
+	return id1 != 0 ? id1 - 1 : DCPU_SYMBOL_NONE;
+}
+
+u32 SymbolTable::intern(const char * name, u32 size)
+{
+	const u32 h = hash(name, size);
+	u32 slot = findSlot(name, size, h);
+	if(m_slots[slot] != 0)
+		return m_slots[slot] - 1;
+
+	// Keep the table at most half full
+	if(2 * (m_symbols.size() + 1) > m_slots.size())
+	{
+		grow();
+		slot = findSlot(name, size, h);
+	}
+
+	Symbol s;
+	s.offset = m_names.size();
+	s.size = size;
+	s.hash = h;
+	m_names.insert(m_names.end(), name, name + size);
+	m_symbols.push_back(s);
+
+	m_slots[slot] = m_symbols.size();
+	return m_symbols.size() - 1;
+}
+
+std::string SymbolTable::getName(u32 id) const
+{
+	const Symbol & s = m_symbols[id];
+	return std::string(m_names.begin() + s.offset, m_names.begin() + s.offset + s.size);
+}
+
+void SymbolTable::grow()
+{
+	m_slots.assign(m_slots.size() * 2, 0);
+
+	const u32 mask = m_slots.size() - 1;
+	for(u32 id = 0; id < m_symbols.size(); ++id)
+	{
+		u32 slot = m_symbols[id].hash & mask;
+		while(m_slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		m_slots[slot] = id + 1;
+	}
+}
+
+} // namespace dcpu
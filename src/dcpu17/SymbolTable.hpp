@@ -0,0 +1,66 @@
+#ifndef HEADER_DCPU_SYMBOLTABLE_HPP_INCLUDED
+#define HEADER_DCPU_SYMBOLTABLE_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include "common.hpp"
+
+// ID returned when a name is not in the table
+#define DCPU_SYMBOL_NONE 0xffffffff
+
+namespace dcpu
+{
+//
+// Interned names: each name is stored once and identified by an integer ID
+// (0, 1, 2... in insertion order). Names are stored back to back in one
+// growing buffer and found through an open-addressing hash table, so adding
+// a name costs no allocation most of the time.
+//
+class SymbolTable
+{
+public :
+
+	SymbolTable();
+
+	// Returns the ID of a name, adding it if it is not in the table yet
+	u32 intern(const char * name, u32 size);
+	u32 intern(const std::string & name) { return intern(name.data(), name.size()); }
+
+	// Returns the ID of a name, or DCPU_SYMBOL_NONE if it is not in the table
+	u32 find(const char * name, u32 size) const;
+	u32 find(const std::string & name) const { return find(name.data(), name.size()); }
+
+	// Number of names (IDs go from 0 to getCount() - 1)
+	u32 getCount() const { return m_symbols.size(); }
+
+	// Returns the name of an ID
+	std::string getName(u32 id) const;
+
+	// Removes all names
+	void clear();
+
+private :
+
+	struct Symbol
+	{
+		u32 offset; // in m_names
+		u32 size;
+		u32 hash;
+	};
+
+	static u32 hash(const char * name, u32 size);
+
+	// Returns the slot where the name is, or the empty slot where it would be
+	u32 findSlot(const char * name, u32 size, u32 h) const;
+
+	// Doubles the hash table size
+	void grow();
+
+	std::vector<char> m_names; // All names, back to back
+	std::vector<Symbol> m_symbols; // Indexed by ID
+	std::vector<u32> m_slots; // ID + 1 (0 means empty), size is a power of two
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_SYMBOLTABLE_HPP_INCLUDED
@@ -0,0 +1,437 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include "TerminalRenderer.hpp"
+
+#ifndef WINDOWS
+	#include <errno.h>
+	#include <poll.h>
+	#include <unistd.h>
+#endif
+
+// Glyph ids above 0xff are shades (see render())
+#define DCPU_TERM_SHADE 0x100
+// Terminal state not known (forces the next write)
+#define DCPU_TERM_UNKNOWN 0xffff
+
+namespace dcpu
+{
+// UTF-8 shades, from empty to full
+static const char * s_shades[5] = { " ", "\xe2\x96\x91", "\xe2\x96\x92", "\xe2\x96\x93", "\xe2\x96\x88" };
+
+// Output that is thrown away
+class NullBuffer : public std::streambuf
+{
+protected :
+
+	virtual int overflow(int c) { return traits_type::not_eof(c); }
+};
+
+static NullBuffer s_nullBuffer;
+
+// Input parser states
+enum TerminalEscapeStates
+{
+	TES_NONE = 0,
+	TES_ESCAPE,  // After ESC
+	TES_SEQUENCE // After ESC [ or ESC O
+};
+
+TerminalRenderer::TerminalRenderer()
+{
+	m_open = false;
+	m_colorMode = COLORS_256;
+	m_escape = TES_NONE;
+	m_escapeNumber = 0;
+	r_coutBuffer = 0;
+	invalidate();
+}
+
+TerminalRenderer::~TerminalRenderer()
+{
+	close();
+}
+
+TerminalRenderer::ColorMode TerminalRenderer::detectColorMode()
+{
+	const char * colorterm = std::getenv("COLORTERM");
+	if(colorterm != 0 && (strcmp(colorterm, "truecolor") == 0 || strcmp(colorterm, "24bit") == 0))
+		return COLORS_TRUE;
+	return COLORS_256;
+}
+
+bool TerminalRenderer::open(ColorMode colorMode)
+{
+	close();
+
+#ifdef WINDOWS
+	std::cout << "E: TerminalRenderer: not supported on this platform" << std::endl;
+	return false;
+#else
+	if(!isatty(STDIN_FILENO) || !isatty(STDOUT_FILENO))
+	{
+		std::cout << "E: TerminalRenderer: stdin and stdout must be a terminal" << std::endl;
+		return false;
+	}
+
+	if(tcgetattr(STDIN_FILENO, &m_savedTermios) != 0)
+	{
+		std::cout << "E: TerminalRenderer: couldn't get terminal attributes" << std::endl;
+		return false;
+	}
+
+	// Raw input: no line buffering, no echo, no signals, and reads
+	// return immediately so the emulator never waits for a key
+	termios raw = m_savedTermios;
+	raw.c_iflag &= ~(IXON | ICRNL | INLCR | ISTRIP);
+	raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	if(tcsetattr(STDIN_FILENO, TCSAFLUSH, &raw) != 0)
+	{
+		std::cout << "E: TerminalRenderer: couldn't set raw mode" << std::endl;
+		return false;
+	}
+
+	// The screen is only written by render(), which assumes the
+	// terminal shows nothing else
+	std::cout.flush();
+	r_coutBuffer = std::cout.rdbuf(isatty(STDERR_FILENO) ? &s_nullBuffer : std::cerr.rdbuf());
+
+	m_open = true;
+	m_colorMode = colorMode;
+	m_escape = TES_NONE;
+	invalidate();
+
+	// Hide cursor
+	m_out = "\x1b[?25l";
+	flush();
+
+	return true;
+#endif
+}
+
+void TerminalRenderer::close()
+{
+	if(!m_open)
+		return;
+
+#ifndef WINDOWS
+	// Reset colors, show cursor and leave it below the screen
+	m_out = "\x1b[0m\x1b[?25h\x1b[";
+	appendNumber(DCPU_LEM1802_NTILES_Y + 1);
+	m_out += ";1H\n";
+	flush();
+
+	tcsetattr(STDIN_FILENO, TCSAFLUSH, &m_savedTermios);
+
+	std::cout.flush();
+	std::cout.rdbuf(r_coutBuffer);
+	r_coutBuffer = 0;
+#endif
+	m_open = false;
+}
+
+void TerminalRenderer::invalidate()
+{
+	m_redrawAll = true;
+}
+
+u32 TerminalRenderer::render(LEM1802 & lem, const DCPU & dcpu)
+{
+	if(!m_open)
+		return 0;
+
+	m_out.clear();
+
+	if(m_redrawAll)
+	{
+		// Reset attributes, clear, and forget what the terminal shows
+		m_out += "\x1b[0m\x1b[2J";
+		for(u32 i = 0; i < DCPU_LEM1802_VRAM_SIZE; ++i)
+		{
+			m_cells[i].glyph = DCPU_TERM_UNKNOWN;
+			m_cells[i].fg = DCPU_TERM_UNKNOWN;
+			m_cells[i].bg = DCPU_TERM_UNKNOWN;
+		}
+		m_cursor = DCPU_TERM_UNKNOWN;
+		m_fg = DCPU_TERM_UNKNOWN;
+		m_bg = DCPU_TERM_UNKNOWN;
+		m_redrawAll = false;
+	}
+
+	const u16 vramAddr = lem.getVRAMAddr();
+	const u16 * palette = lem.getPalette();
+	const u16 * font = lem.getFont();
+	const bool defaultFont = lem.isDefaultFont();
+	const bool blinkVisible = lem.isBlinkVisible();
+	const u16 * ram = dcpu.getMemory();
+
+	for(u32 i = 0; i < DCPU_LEM1802_VRAM_SIZE; ++i)
+	{
+		Cell cell;
+		if(vramAddr == 0)
+		{
+			// Disconnected screen
+			cell.glyph = ' ';
+			cell.fg = 0;
+			cell.bg = 0;
+		}
+		else
+		{
+			// Same layout as LEM1802 tiles: ffffbbbbBccccccc
+			const u16 word = ram[(vramAddr + i) & 0xffff];
+			const u8 c = word & 0x7f;
+			cell.fg = palette[(word >> 12) & 0xf] & 0xfff;
+			cell.bg = palette[(word >> 8) & 0xf] & 0xfff;
+
+			if((word & 0x80) && !blinkVisible)
+				cell.glyph = ' ';
+			else if(defaultFont && c >= 0x20 && c < 0x7f)
+				cell.glyph = c;
+			else
+			{
+				// Custom glyphs are approximated by how many pixels they light
+				u32 bits = font[2*c] | (static_cast<u32>(font[2*c+1]) << 16);
+				u32 n = 0;
+				for(; bits != 0; bits &= bits - 1)
+					++n;
+				cell.glyph = DCPU_TERM_SHADE + (n * 4 + 31) / 32;
+			}
+		}
+
+		// Colors that can't be seen don't need to change
+		if(cell.glyph == ' ' || cell.glyph == DCPU_TERM_SHADE || cell.fg == cell.bg)
+		{
+			cell.glyph = ' ';
+			cell.fg = cell.bg;
+		}
+		else if(cell.glyph == DCPU_TERM_SHADE + 4)
+			cell.bg = cell.fg;
+
+		Cell & shown = m_cells[i];
+		if(shown.glyph == cell.glyph && shown.fg == cell.fg && shown.bg == cell.bg)
+			continue;
+		shown = cell;
+
+		// Move the cursor, unless it already is there after the last cell
+		if(m_cursor != i)
+		{
+			const u16 row = i / DCPU_LEM1802_NTILES_X;
+			const u16 col = i % DCPU_LEM1802_NTILES_X;
+			if(m_cursor != DCPU_TERM_UNKNOWN && m_cursor / DCPU_LEM1802_NTILES_X == row && m_cursor < i)
+			{
+				m_out += "\x1b[";
+				appendNumber(i - m_cursor);
+				m_out += 'C';
+			}
+			else
+			{
+				m_out += "\x1b[";
+				appendNumber(row + 1);
+				m_out += ';';
+				appendNumber(col + 1);
+				m_out += 'H';
+			}
+		}
+
+		appendColors(cell.fg, cell.bg);
+
+		if(cell.glyph < DCPU_TERM_SHADE)
+			m_out += static_cast<char>(cell.glyph);
+		else
+			m_out += s_shades[cell.glyph - DCPU_TERM_SHADE];
+
+		// The last column may leave the cursor in a pending wrap state
+		m_cursor = (i + 1) % DCPU_LEM1802_NTILES_X == 0 ? DCPU_TERM_UNKNOWN : i + 1;
+	}
+
+	const u32 size = m_out.size();
+	if(size == 0)
+		return 0;
+	if(!flush())
+		return 0;
+	return size;
+}
+
+void TerminalRenderer::appendColors(u16 fg, u16 bg)
+{
+	if(fg == m_fg && bg == m_bg)
+		return;
+
+	// One SGR sequence for both colors
+	m_out += "\x1b[";
+	if(fg != m_fg)
+	{
+		appendColor(false, fg);
+		if(bg != m_bg)
+			m_out += ';';
+	}
+	if(bg != m_bg)
+		appendColor(true, bg);
+	m_out += 'm';
+
+	m_fg = fg;
+	m_bg = bg;
+}
+
+void TerminalRenderer::appendColor(bool background, u16 color)
+{
+	// 4-bit components of a 0x0rgb palette word
+	const u8 r = (color >> 8) & 0xf;
+	const u8 g = (color >> 4) & 0xf;
+	const u8 b = color & 0xf;
+
+	m_out += background ? "48;" : "38;";
+	if(m_colorMode == COLORS_TRUE)
+	{
+		m_out += "2;";
+		appendNumber(r * 17);
+		m_out += ';';
+		appendNumber(g * 17);
+		m_out += ';';
+		appendNumber(b * 17);
+	}
+	else
+	{
+		// Nearest level of the xterm cube (0, 95, 135, 175, 215, 255)
+		static const u8 levels[16] = { 0,0,0,1,1,1,1,2,2,3,3,3,4,4,5,5 };
+		m_out += "5;";
+		appendNumber(16 + 36 * levels[r] + 6 * levels[g] + levels[b]);
+	}
+}
+
+void TerminalRenderer::appendNumber(u32 n)
+{
+	char digits[10];
+	u8 count = 0;
+	do
+	{
+		digits[count++] = '0' + n % 10;
+		n /= 10;
+	} while(n != 0);
+	while(count != 0)
+		m_out += digits[--count];
+}
+
+bool TerminalRenderer::flush()
+{
+#ifdef WINDOWS
+	m_out.clear();
+	return false;
+#else
+	// A single write, unless the terminal takes less at once
+	const char * data = m_out.data();
+	u32 left = m_out.size();
+	while(left != 0)
+	{
+		ssize_t n = ::write(STDOUT_FILENO, data, left);
+		if(n < 0)
+		{
+			if(errno == EINTR || errno == EAGAIN)
+				continue;
+			m_out.clear();
+			invalidate();
+			return false;
+		}
+		data += n;
+		left -= n;
+	}
+	m_out.clear();
+	return true;
+#endif
+}
+
+void TerminalRenderer::waitInput(u32 timeout)
+{
+	if(!m_open)
+		return;
+
+#ifndef WINDOWS
+	pollfd fd;
+	fd.fd = STDIN_FILENO;
+	fd.events = POLLIN;
+	fd.revents = 0;
+	poll(&fd, 1, timeout);
+#else
+	(void)timeout;
+#endif
+}
+
+bool TerminalRenderer::processInput(Keyboard & keyboard)
+{
+	if(!m_open)
+		return true;
+
+#ifndef WINDOWS
+	u8 buffer[64];
+	ssize_t count;
+	while((count = ::read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+	{
+		for(ssize_t i = 0; i < count; ++i)
+		{
+			const u8 b = buffer[i];
+
+			if(m_escape == TES_ESCAPE)
+			{
+				if(b == '[' || b == 'O')
+				{
+					m_escape = TES_SEQUENCE;
+					m_escapeNumber = 0;
+					continue;
+				}
+				// Not a sequence (Alt+key): read b as a normal key
+				m_escape = TES_NONE;
+			}
+			else if(m_escape == TES_SEQUENCE)
+			{
+				if(b >= '0' && b <= '9')
+				{
+					m_escapeNumber = m_escapeNumber * 10 + (b - '0');
+					continue;
+				}
+				if(b == ';')
+				{
+					// Modifiers are ignored
+					m_escapeNumber = 0;
+					continue;
+				}
+
+				switch(b)
+				{
+				case 'A': keyboard.typeKey(KB_UP); break;
+				case 'B': keyboard.typeKey(KB_DOWN); break;
+				case 'C': keyboard.typeKey(KB_RIGHT); break;
+				case 'D': keyboard.typeKey(KB_LEFT); break;
+				case '~':
+					if(m_escapeNumber == 2)
+						keyboard.typeKey(KB_INSERT);
+					else if(m_escapeNumber == 3)
+						keyboard.typeKey(KB_DELETE);
+					break;
+				default: break;
+				}
+				m_escape = TES_NONE;
+				continue;
+			}
+
+			if(b == 0x03) // Ctrl+C
+				return false;
+			else if(b == 0x1b)
+				m_escape = TES_ESCAPE;
+			else if(b == '\r' || b == '\n')
+				keyboard.typeKey(KB_RETURN);
+			else if(b == 0x7f || b == 0x08)
+				keyboard.typeKey(KB_BACKSPACE);
+			else if(b >= KB_ASCII_BEG && b < KB_ASCII_END)
+				keyboard.typeKey(b);
+		}
+	}
+#else
+	(void)keyboard;
+#endif
+	return true;
+}
+
+} // namespace dcpu
@@ -0,0 +1,97 @@
+#ifndef HEADER_DCPU_TERMINALRENDERER_HPP_INCLUDED
+#define HEADER_DCPU_TERMINALRENDERER_HPP_INCLUDED
+
+#include <iostream>
+#include <string>
+
+#ifndef WINDOWS
+	#include <termios.h>
+#endif
+
+#include "LEM1802.hpp"
+#include "Keyboard.hpp"
+
+namespace dcpu
+{
+
+/*
+	Draws a LEM1802 screen in an ANSI terminal (one character cell per tile)
+	and reads the terminal's keys for a Keyboard device.
+	Only cells that changed since the last frame are written, and a whole
+	frame goes out in one write.
+*/
+class TerminalRenderer
+{
+public :
+
+	enum ColorMode
+	{
+		COLORS_256 = 0, // xterm 6x6x6 color cube
+		COLORS_TRUE     // 24-bit colors
+	};
+
+	TerminalRenderer();
+	~TerminalRenderer();
+
+	// Puts the terminal in raw mode and clears it.
+	// Until close(), std::cout goes to stderr if it is not the terminal,
+	// or nowhere (logs would be drawn over the screen).
+	// Returns false if stdin/stdout is not a terminal.
+	bool open(ColorMode colorMode);
+
+	// Restores the terminal as it was before open()
+	void close();
+
+	bool isOpen() const { return m_open; }
+
+	// Guesses the color mode from the environment (COLORTERM)
+	static ColorMode detectColorMode();
+
+	// Draws cells of lem that changed since the last call.
+	// Returns the number of bytes written to the terminal.
+	u32 render(LEM1802 & lem, const DCPU & dcpu);
+
+	// Forces the next render() to redraw every cell
+	void invalidate();
+
+	// Reads pending keys from the terminal and types them on keyboard.
+	// Returns false when the user asked to quit (Ctrl+C).
+	bool processInput(Keyboard & keyboard);
+
+	// Blocks until a key is pressed or timeout milliseconds passed
+	void waitInput(u32 timeout);
+
+private :
+
+	// What a terminal cell currently shows
+	struct Cell
+	{
+		u16 glyph; // ASCII code, or a shade
+		u16 fg;    // 12-bit palette colors
+		u16 bg;
+	};
+
+	void appendColors(u16 fg, u16 bg);
+	void appendColor(bool background, u16 color);
+	void appendNumber(u32 n);
+	bool flush();
+
+	bool m_open;
+	ColorMode m_colorMode;
+	Cell m_cells[DCPU_LEM1802_VRAM_SIZE];
+	bool m_redrawAll;
+	u16 m_cursor;       // Cell under the terminal cursor
+	u16 m_fg;           // Current terminal colors
+	u16 m_bg;
+	std::string m_out;  // Frame being built
+	u8 m_escape;        // Escape sequence state of the input parser
+	u16 m_escapeNumber; // Numeric parameter of the escape sequence
+	std::streambuf * r_coutBuffer; // Buffer of std::cout before open()
+#ifndef WINDOWS
+	termios m_savedTermios; // Terminal settings restored by close()
+#endif
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_TERMINALRENDERER_HPP_INCLUDED
@@ -0,0 +1,67 @@
+#ifdef WINDOWS
+	#include <windows.h>
+#else // Assumed POSIX
+	#include <unistd.h>
+#endif
+
+#include "ThreadPool.hpp"
+
+namespace dcpu
+{
+ThreadPool::ThreadPool(u32 threadCount)
+{
+	m_threadCount = threadCount != 0 ? threadCount : 1;
+	r_task = 0;
+	m_jobCount = 0;
+	m_nextJob = 0;
+}
+
+void ThreadPool::run(IParallelTask & task, u32 jobCount)
+{
+	r_task = &task;
+	m_jobCount = jobCount;
+	m_nextJob = 0;
+
+	// No more threads than jobs
+	std::vector<sf::Thread*> threads;
+	for(u32 i = 1; i < m_threadCount && i < jobCount; ++i)
+	{
+		threads.push_back(new sf::Thread(&ThreadPool::work, this));
+		threads.back()->launch();
+	}
+
+	work();
+
+	for(u32 i = 0; i < threads.size(); ++i)
+	{
+		threads[i]->wait();
+		delete threads[i];
+	}
+
+	r_task = 0;
+}
+
+void ThreadPool::work()
+{
+	while(true)
+	{
+		const u32 job = __sync_fetch_and_add(&m_nextJob, 1);
+		if(job >= m_jobCount)
+			return;
+		r_task->runJob(job);
+	}
+}
+
+u32 ThreadPool::getProcessorCount()
+{
+#ifdef WINDOWS
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors != 0 ? info.dwNumberOfProcessors : 1;
+#else
+	const long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? count : 1;
+#endif
+}
+
+} // namespace dcpu
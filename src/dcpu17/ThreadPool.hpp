@@ -0,0 +1,60 @@
+#ifndef HEADER_DCPU_THREADPOOL_HPP_INCLUDED
+#define HEADER_DCPU_THREADPOOL_HPP_INCLUDED
+
+#include <vector>
+#include <SFML/System.hpp>
+
+#include "common.hpp"
+
+namespace dcpu
+{
+// Work split into independent jobs, given to a ThreadPool
+class IParallelTask
+{
+public :
+
+	virtual ~IParallelTask() {}
+
+	// Does job number index. Called from any thread,
+	// at the same time as other jobs.
+	virtual void runJob(u32 index) = 0;
+};
+
+/*
+	Runs the jobs of a task on several threads.
+	Each thread takes the next job not taken yet, so long jobs
+	don't hold the others. The calling thread also runs jobs.
+
+	SFML has no condition variable, so threads are only started for
+	the duration of run() instead of waiting for work.
+*/
+class ThreadPool
+{
+public :
+
+	// threadCount includes the calling thread (1 runs everything on it)
+	ThreadPool(u32 threadCount);
+
+	u32 getThreadCount() const { return m_threadCount; }
+
+	// Calls task.runJob(i) for each i from 0 to jobCount - 1.
+	// Returns when all jobs are done.
+	void run(IParallelTask & task, u32 jobCount);
+
+	// Number of processors available to the program (at least 1)
+	static u32 getProcessorCount();
+
+private :
+
+	// Thread function: runs jobs until there are none left
+	void work();
+
+	u32 m_threadCount;
+	IParallelTask * r_task;
+	u32 m_jobCount;
+	volatile u32 m_nextJob;
+};
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_THREADPOOL_HPP_INCLUDED
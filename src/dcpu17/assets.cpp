@@ -0,0 +1,139 @@
+#include "assets.hpp"
+
+namespace dcpu
+{
+// Generated from assets/lem1802/charset.png
+// (dcpu -cvf assets/lem1802/charset.png gives the same words)
+const u16 g_lem1802DefaultFont[DCPU_LEM1802_FONT_SIZE] = {
+	0x000f, 0x0808,
+	0x080f, 0x0808,
+	0x08f8, 0x0808,
+	0x00ff, 0x0808,
+	0x0808, 0x0808,
+	0x08ff, 0x0808,
+	0x00ff, 0x1414,
+	0xff00, 0xff08,
+	0x1f10, 0x1714,
+	0xfc04, 0xf414,
+	0x1710, 0x1714,
+	0xf404, 0xf414,
+	0xff00, 0xf714,
+	0x1414, 0x1414,
+	0xf700, 0xf714,
+	0x1417, 0x1414,
+	0x0f08, 0x0f08,
+	0x14f4, 0x1414,
+	0xf808, 0xf808,
+	0x0f08, 0x0f08,
+	0x001f, 0x1414,
+	0x00fc, 0x1414,
+	0xf808, 0xf808,
+	0xff08, 0xff08,
+	0x14ff, 0x1414,
+	0x080f, 0x0000,
+	0x00f8, 0x0808,
+	0xffff, 0xffff,
+	0xf0f0, 0xf0f0,
+	0xffff, 0x0000,
+	0x0000, 0xffff,
+	0x0f0f, 0x0f0f,
+	0x0000, 0x0000, // ' '
+	0x005f, 0x0000, // '!'
+	0x0300, 0x0300, // '"'
+	0x3e14, 0x3e00, // '#'
+	0x266b, 0x3200, // '$'
+	0x611c, 0x4300, // '%'
+	0x3629, 0x7650, // '&'
+	0x0002, 0x0100, // '''
+	0x1c22, 0x4100, // '('
+	0x4122, 0x1c00, // ')'
+	0x2a1c, 0x2a00, // '*'
+	0x083e, 0x0800, // '+'
+	0x4020, 0x0000, // ','
+	0x0808, 0x0800, // '-'
+	0x0040, 0x0000, // '.'
+	0x601c, 0x0300, // '/'
+	0x3e41, 0x3e00, // '0'
+	0x427f, 0x4000, // '1'
+	0x6259, 0x4600, // '2'
+	0x2249, 0x3600, // '3'
+	0x0f08, 0x7f00, // '4'
+	0x2745, 0x3900, // '5'
+	0x3e49, 0x3200, // '6'
+	0x6119, 0x0700, // '7'
+	0x3649, 0x3600, // '8'
+	0x2649, 0x3e00, // '9'
+	0x0024, 0x0000, // ':'
+	0x4024, 0x0000, // ';'
+	0x0814, 0x2241, // '<'
+	0x1414, 0x1400, // '='
+	0x4122, 0x1408, // '>'
+	0x0259, 0x0600, // '?'
+	0x3e59, 0x5e00, // '@'
+	0x7e09, 0x7e00, // 'A'
+	0x7f49, 0x3600, // 'B'
+	0x3e41, 0x2200, // 'C'
+	0x7f41, 0x3e00, // 'D'
+	0x7f49, 0x4100, // 'E'
+	0x7f09, 0x0100, // 'F'
+	0x3e49, 0x3a00, // 'G'
+	0x7f08, 0x7f00, // 'H'
+	0x417f, 0x4100, // 'I'
+	0x2040, 0x3f00, // 'J'
+	0x7f0c, 0x7300, // 'K'
+	0x7f40, 0x4000, // 'L'
+	0x7f06, 0x7f00, // 'M'
+	0x7f01, 0x7e00, // 'N'
+	0x3e41, 0x3e00, // 'O'
+	0x7f09, 0x0600, // 'P'
+	0x3e41, 0xbe00, // 'Q'
+	0x7f09, 0x7600, // 'R'
+	0x2649, 0x3200, // 'S'
+	0x017f, 0x0100, // 'T'
+	0x7f40, 0x7f00, // 'U'
+	0x1f60, 0x1f00, // 'V'
+	0x7f30, 0x7f00, // 'W'
+	0x7708, 0x7700, // 'X'
+	0x0778, 0x0700, // 'Y'
+	0x7149, 0x4700, // 'Z'
+	0x007f, 0x4100, // '['
+	0x031c, 0x6000, // '\\'
+	0x0041, 0x7f00, // ']'
+	0x0201, 0x0200, // '^'
+	0x8080, 0x8000, // '_'
+	0x0001, 0x0200, // '`'
+	0x2454, 0x7800, // 'a'
+	0x7f44, 0x3800, // 'b'
+	0x3844, 0x2800, // 'c'
+	0x3844, 0x7f00, // 'd'
+	0x3854, 0x5800, // 'e'
+	0x087e, 0x0900, // 'f'
+	0x4854, 0x3c00, // 'g'
+	0x7f04, 0x7800, // 'h'
+	0x447d, 0x4000, // 'i'
+	0x2040, 0x3d00, // 'j'
+	0x7f10, 0x6c00, // 'k'
+	0x417f, 0x4000, // 'l'
+	0x7c18, 0x7c00, // 'm'
+	0x7c04, 0x7800, // 'n'
+	0x3844, 0x3800, // 'o'
+	0x7c14, 0x0800, // 'p'
+	0x0814, 0x7c00, // 'q'
+	0x7c04, 0x0800, // 'r'
+	0x4854, 0x2400, // 's'
+	0x043e, 0x4400, // 't'
+	0x3c40, 0x7c00, // 'u'
+	0x1c60, 0x1c00, // 'v'
+	0x7c30, 0x7c00, // 'w'
+	0x6c10, 0x6c00, // 'x'
+	0x4c50, 0x3c00, // 'y'
+	0x6454, 0x4c00, // 'z'
+	0x0836, 0x4100, // '{'
+	0x0077, 0x0000, // '|'
+	0x4136, 0x0800, // '}'
+	0x0201, 0x0201, // '~'
+	0x704c, 0x7000
+};
+
+} // namespace dcpu
+
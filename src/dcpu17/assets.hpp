@@ -0,0 +1,24 @@
+#ifndef HEADER_DCPU_ASSETS_HPP_INCLUDED
+#define HEADER_DCPU_ASSETS_HPP_INCLUDED
+
+//
+// Assets compiled into the executable, so the emulator can start without
+// reading anything from the disk. Files in an assets directory like
+// DCPU_ASSETS_DIR can still be used to override them (see -assets).
+//
+
+#include "common.hpp"
+
+// Size of a LEM1802 font in words (128 glyphs, 2 words each)
+#define DCPU_LEM1802_FONT_SIZE 256
+
+namespace dcpu
+{
+// Default LEM1802 charset as fontcode words
+// (same content as assets/lem1802/charset.png).
+// It is also used to draw the emulator's overlay text.
+extern const u16 g_lem1802DefaultFont[DCPU_LEM1802_FONT_SIZE];
+
+} // namespace dcpu
+
+#endif // HEADER_DCPU_ASSETS_HPP_INCLUDED
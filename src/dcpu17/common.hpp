@@ -17,6 +17,9 @@ namespace dcpu
     typedef signed short s16;
     typedef signed long s32;
     typedef signed long s64;
+
+    // DCPU registers A, B, C, X, Y, Z, I, J
+    typedef u16 RegisterFile[8];
 }
 
 #endif // HEADER_DCPUCOMMON_HPP_INCLUDED
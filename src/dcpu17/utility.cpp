@@ -3,6 +3,9 @@
 
 #include "utility.hpp"
 #include "Assembler.hpp"
+#include "AssemblyCache.hpp"
+#include "Linker.hpp"
+#include "ParallelAssembler.hpp"
 #include "Preprocessor.hpp"
 
 namespace dcpu
@@ -92,8 +95,31 @@ bool convertImageToDASMFont(
 	return true;
 }
 
-bool loadProgram(DCPU & cpu, const std::string & filename)
+// Preprocesses a program for the assembler
+static bool preprocessTokens(
+	Preprocessor & preprocessor,
+	const std::vector<std::string> & includePaths,
+	std::vector<Token> & tokens)
 {
+	for(u32 i = 0; i < includePaths.size(); ++i)
+		preprocessor.addIncludePath(includePaths[i]);
+	if(!preprocessor.process(tokens))
+	{
+		std::cout << "E: Preprocessor: "
+			<< preprocessor.getExceptionString() << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool loadProgram(DCPU & cpu, const std::string & filename,
+	const std::vector<std::string> & includePaths,
+	const std::string & cacheDir)
+{
+	// Linked programs are already assembled
+	if(filename.size() > 4 && filename.compare(filename.size() - 4, 4, ".bin") == 0)
+		return loadImage(cpu, filename);
+
 	std::ifstream ifs(filename.c_str(), std::ios::binary|std::ios::in);
 	if(!ifs.good())
 	{
@@ -102,9 +128,35 @@ bool loadProgram(DCPU & cpu, const std::string & filename)
 		return false;
 	}
 
-	Assembler assembler;
+	// The preprocessor gives tokens to the assembler, which don't need
+	// to be written as text again. They point into the preprocessor.
+	Preprocessor preprocessor(ifs, filename);
+	std::vector<Token> tokens;
+	if(!preprocessTokens(preprocessor, includePaths, tokens))
+		return false;
+
+	// Unchanged sources were already assembled
+	AssemblyCache cache(cacheDir);
+	AssembledProgram program;
+	sf::Uint64 key = 0;
+	if(!cacheDir.empty())
+	{
+		key = AssemblyCache::computeKey(tokens, preprocessor.getIncludedFiles());
+		if(cache.load(key, program))
+		{
+			std::vector<u16> ram(DCPU_RAM_SIZE);
+			program.getMemory(&ram[0]);
+			cpu.setMemory(&ram[0]);
+			std::cout << "I: Assembly cache: loaded '" << filename << "'" << std::endl;
+			return true;
+		}
+	}
+
+	// Large programs are assembled on several threads
+	ParallelAssembler assembler;
+	ObjectFile object;
 	std::cout << "Start assembling..." << std::endl;
-	bool res = assembler.assembleStream(ifs);
+	bool res = assembler.assembleTokens(tokens, object, false, &preprocessor.getFileNames());
 	if(!res)
 	{
 		std::cout << "E: " << assembler.getExceptionString() << std::endl;
@@ -112,8 +164,21 @@ bool loadProgram(DCPU & cpu, const std::string & filename)
 	}
 	else
 	{
-		cpu.setMemory(assembler.getAssembly());
+		program.set(object);
+		std::vector<u16> ram(DCPU_RAM_SIZE);
+		program.getMemory(&ram[0]);
+		cpu.setMemory(&ram[0]);
 		std::cout << "Assembling finished." << std::endl;
+
+		if(!cacheDir.empty())
+		{
+			if(!cache.save(key, program))
+			{
+				// Not an error, the program will be assembled next time
+				std::cout << "I: Assembly cache: couldn't write in '"
+					<< cacheDir << "'" << std::endl;
+			}
+		}
 	}
 
 	ifs.close();
@@ -181,7 +246,8 @@ bool dumpAsImage(const DCPU & cpu, const std::string & filename)
 
 bool preprocessFile(
 	const std::string & inputFilename,
-	const std::string & outputFilename)
+	const std::string & outputFilename,
+	const std::vector<std::string> & includePaths)
 {
 	std::ifstream ifs(inputFilename.c_str(), std::ios::in|std::ios::binary);
 	if(!ifs.good())
@@ -200,8 +266,10 @@ bool preprocessFile(
 		return false;
 	}
 
-	Preprocessor preprocessor(ifs, ofs);
-	if(!preprocessor.process())
+	Preprocessor preprocessor(ifs, inputFilename);
+	for(u32 i = 0; i < includePaths.size(); ++i)
+		preprocessor.addIncludePath(includePaths[i]);
+	if(!preprocessor.process(ofs))
 	{
 		std::cout << "E: Preprocessor: "
 			<< preprocessor.getExceptionString() << std::endl;
@@ -213,10 +281,237 @@ bool preprocessFile(
 	return true;
 }
 
+bool assembleObject(
+	const std::string & inputFilename,
+	const std::string & outputFilename,
+	const std::vector<std::string> & includePaths)
+{
+	std::ifstream ifs(inputFilename.c_str(), std::ios::in|std::ios::binary);
+	if(!ifs.good())
+	{
+		std::cout << "E: couldn't open file '"
+			<< inputFilename << "'" << std::endl;
+		return false;
+	}
+
+	Preprocessor preprocessor(ifs, inputFilename);
+	std::vector<Token> tokens;
+	if(!preprocessTokens(preprocessor, includePaths, tokens))
+		return false;
+
+	ParallelAssembler assembler;
+	ObjectFile object;
+	std::cout << "Start assembling..." << std::endl;
+	if(!assembler.assembleTokens(tokens, object, true, &preprocessor.getFileNames()))
+	{
+		std::cout << "E: " << assembler.getExceptionString() << std::endl;
+		std::cout << "Assembling failed." << std::endl;
+		return false;
+	}
+	std::cout << "Assembling finished." << std::endl;
+
+	if(!object.save(outputFilename))
+	{
+		std::cout << "E: couldn't write file '"
+			<< outputFilename << "'" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Links objects and saves the program image
+static bool linkAndSave(
+	const std::vector<ObjectFile> & objects,
+	const std::vector<std::string> & names,
+	const std::string & outputFilename)
+{
+	Linker linker;
+	for(u32 i = 0; i < objects.size(); ++i)
+		linker.addObject(objects[i], names[i]);
+
+	std::vector<u16> ram(DCPU_RAM_SIZE);
+	if(!linker.link(&ram[0]))
+	{
+		std::cout << "E: Linker: " << linker.getExceptionString() << std::endl;
+		return false;
+	}
+
+	u32 size = 0;
+	for(u32 i = 0; i < objects.size(); ++i)
+		size += objects[i].section.size();
+
+	std::ofstream ofs(outputFilename.c_str(),
+		std::ios::out|std::ios::trunc|std::ios::binary);
+	for(u32 i = 0; i < size; ++i)
+		writeU16(ofs, ram[i]);
+	ofs.close();
+	if(ofs.fail())
+	{
+		std::cout << "E: couldn't write file '"
+			<< outputFilename << "'" << std::endl;
+		return false;
+	}
+
+	std::cout << "I: Linked " << objects.size() << " objects ("
+		<< size << " words)." << std::endl;
+	return true;
+}
+
+bool linkObjects(
+	const std::vector<std::string> & objectFilenames,
+	const std::string & outputFilename)
+{
+	std::vector<ObjectFile> objects(objectFilenames.size());
+	for(u32 i = 0; i < objects.size(); ++i)
+	{
+		if(!objects[i].load(objectFilenames[i]))
+		{
+			std::cout << "E: couldn't read object file '"
+				<< objectFilenames[i] << "'" << std::endl;
+			return false;
+		}
+	}
+
+	return linkAndSave(objects, objectFilenames, outputFilename);
+}
+
+bool buildProgram(
+	const std::vector<std::string> & inputFilenames,
+	const std::string & outputFilename,
+	const std::vector<std::string> & includePaths)
+{
+	ParallelAssembler assembler;
+	for(u32 i = 0; i < includePaths.size(); ++i)
+		assembler.addIncludePath(includePaths[i]);
+
+	std::cout << "Start assembling " << inputFilenames.size() << " files..." << std::endl;
+	std::vector<ObjectFile> objects;
+	if(!assembler.assembleFiles(inputFilenames, objects))
+	{
+		std::cout << "E: " << assembler.getExceptionString() << std::endl;
+		std::cout << "Assembling failed." << std::endl;
+		return false;
+	}
+	std::cout << "Assembling finished." << std::endl;
+
+	return linkAndSave(objects, inputFilenames, outputFilename);
+}
+
+bool loadImage(DCPU & cpu, const std::string & filename)
+{
+	std::ifstream ifs(filename.c_str(), std::ios::in|std::ios::binary);
+	if(!ifs.good())
+	{
+		std::cout << "E: cannot open file '" << filename << "'" << std::endl;
+		return false;
+	}
+
+	std::vector<u16> ram(DCPU_RAM_SIZE, 0);
+	for(u32 i = 0; i < DCPU_RAM_SIZE && readU16(ifs, ram[i]); ++i)
+	{}
+	if(ifs.bad())
+	{
+		std::cout << "E: couldn't read file '" << filename << "'" << std::endl;
+		return false;
+	}
+
+	cpu.setMemory(&ram[0]);
+	return true;
+}
+
 // -----------------------------------------------------------------------------
 //	General purpose
 // -----------------------------------------------------------------------------
 
+bool fileExists(const std::string & filename)
+{
+	std::ifstream ifs(filename.c_str(), std::ios::in|std::ios::binary);
+	return ifs.good();
+}
+
+bool getCanonicalPath(const std::string & path, std::string & canonical)
+{
+#ifdef WINDOWS
+	char buffer[_MAX_PATH];
+	if(_fullpath(buffer, path.c_str(), _MAX_PATH) == 0 || !fileExists(buffer))
+		return false;
+	canonical = buffer;
+#else
+	// Assume POSIX
+	char * buffer = realpath(path.c_str(), 0);
+	if(buffer == 0)
+		return false;
+	canonical = buffer;
+	std::free(buffer);
+#endif
+	return true;
+}
+
+std::string getDirectory(const std::string & path)
+{
+	const size_t i = path.find_last_of(DIR_CHAR == '/' ? "/" : "/\\");
+	if(i == std::string::npos)
+		return "";
+	return path.substr(0, i + 1);
+}
+
+bool readStream(std::istream & is, std::vector<char> & data)
+{
+	data.clear();
+
+	// Seekable streams (files) are read in one go
+	const std::streampos start = is.tellg();
+	if(start >= 0 && is.seekg(0, std::ios::end))
+	{
+		const std::streampos end = is.tellg();
+		is.seekg(start, std::ios::beg);
+		if(end > start)
+		{
+			data.resize(end - start);
+			is.read(&data[0], data.size());
+			data.resize(is.gcount());
+		}
+		return !is.bad();
+	}
+
+	// Others (pipes) are read by blocks
+	is.clear();
+	char block[4096];
+	while(is.read(block, sizeof(block)) || is.gcount() > 0)
+		data.insert(data.end(), block, block + is.gcount());
+	return !is.bad();
+}
+
+void writeU16(std::ostream & os, u16 value)
+{
+	os.put(value & 0xff);
+	os.put(value >> 8);
+}
+
+void writeU32(std::ostream & os, u32 value)
+{
+	writeU16(os, value & 0xffff);
+	writeU16(os, (value >> 16) & 0xffff);
+}
+
+bool readU16(std::istream & is, u16 & value)
+{
+	u8 bytes[2];
+	if(!is.read((char*)bytes, 2))
+		return false;
+	value = bytes[0] | (bytes[1] << 8);
+	return true;
+}
+
+bool readU32(std::istream & is, u32 & value)
+{
+	u16 low, high;
+	if(!readU16(is, low) || !readU16(is, high))
+		return false;
+	value = low | (static_cast<u32>(high) << 16);
+	return true;
+}
+
 char u4ToHexChar(u8 n)
 {
 	n &= 0xf;
@@ -3,6 +3,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <vector>
 
 #include "DCPU.hpp"
 
@@ -21,9 +22,15 @@ namespace dcpu
 // DCPU utility
 // -----------------------------------------------------------------------------
 
-// Loads, assembles and installs a DCPU program
+// Loads, preprocesses, assembles and installs a DCPU program.
+// Files ending with ".bin" are loaded as images (see loadImage).
+// Included files are also searched in includePaths.
+// If cacheDir is not empty, assembled programs are kept in it
+// and used again while their sources don't change.
 // Returns false if an error occurred.
-bool loadProgram(DCPU & cpu, const std::string & filename);
+bool loadProgram(DCPU & cpu, const std::string & filename,
+	const std::vector<std::string> & includePaths = std::vector<std::string>(),
+	const std::string & cacheDir = "");
 
 // Dumps DCPU memory to a file
 // Returns false if an error occurred.
@@ -40,11 +47,40 @@ bool convertImageToDASMFont(
 	const std::string & outputFilename);
 
 // Performs a preprocessing pass on a file, then saves the result in another file.
+// Included files are also searched in includePaths.
 // Returns false if an error occurred.
 bool preprocessFile(
 	const std::string & inputFilename,
+	const std::string & outputFilename,
+	const std::vector<std::string> & includePaths = std::vector<std::string>());
+
+// Preprocesses and assembles a file into a relocatable object file (see ObjectFile).
+// Included files are also searched in includePaths.
+// Returns false if an error occurred.
+bool assembleObject(
+	const std::string & inputFilename,
+	const std::string & outputFilename,
+	const std::vector<std::string> & includePaths = std::vector<std::string>());
+
+// Links object files into a program image (16-bit little-endian words,
+// from address 0). The first object is at the beginning of the image.
+// Returns false if an error occurred.
+bool linkObjects(
+	const std::vector<std::string> & objectFilenames,
 	const std::string & outputFilename);
 
+// Preprocesses and assembles files into objects on several threads,
+// then links them like linkObjects (without writing object files).
+// Returns false if an error occurred.
+bool buildProgram(
+	const std::vector<std::string> & inputFilenames,
+	const std::string & outputFilename,
+	const std::vector<std::string> & includePaths = std::vector<std::string>());
+
+// Loads a program image written by linkObjects into the DCPU.
+// Returns false if an error occurred.
+bool loadImage(DCPU & cpu, const std::string & filename);
+
 // -----------------------------------------------------------------------------
 //	General purpose
 // -----------------------------------------------------------------------------
@@ -60,6 +96,28 @@ inline void clearConsole()
 #endif
 }
 
+// Returns true if the file exists and can be opened for reading
+bool fileExists(const std::string & filename);
+
+// Gets the absolute path of an existing file, without '.', '..' or links.
+// Returns false if the file doesn't exist.
+bool getCanonicalPath(const std::string & path, std::string & canonical);
+
+// Returns the directory part of a path, with its trailing separator
+// ("" if there is none)
+std::string getDirectory(const std::string & path);
+
+// Reads everything left in a stream into data, in as few reads as possible.
+// Returns false if an error occurred.
+bool readStream(std::istream & is, std::vector<char> & data);
+
+// Write or read integers in binary files, as little-endian whatever the host is.
+// Read functions return false if the end of the stream was reached.
+void writeU16(std::ostream & os, u16 value);
+void writeU32(std::ostream & os, u32 value);
+bool readU16(std::istream & is, u16 & value);
+bool readU32(std::istream & is, u32 & value);
+
 // Converts a 4-bit integer into its ASCII hexadecimal digit
 char u4ToHexChar(u8 n);
 
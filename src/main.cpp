@@ -11,6 +11,7 @@
 #include <fstream>
 
 #include "dcpu17/Emulator.hpp"
+#include "dcpu17/DisplayStream.hpp"
 #include "dcpu17/utility.hpp"
 
 using namespace dcpu;
@@ -22,7 +23,62 @@ int main(int argc, char * argv[])
 	// Handle command line arguments
 
 	std::string programFileName;// = "dasm/text_editor.dasm";
-	if(argc == 2)
+
+	// Optional key script, typed by any emulator command
+	std::string keyScript;
+	if(argc >= 4 && std::string(argv[1]) == "-keys")
+	{
+		keyScript = argv[2];
+		argc -= 2;
+		argv += 2;
+	}
+	// Directories where the preprocessor searches included files,
+	// where assembled programs are cached, and where assets overriding
+	// the embedded ones are (none by default)
+	std::vector<std::string> includePaths;
+	std::string cacheDir;
+	std::string assetsDir;
+	while(argc >= 4)
+	{
+		if(std::string(argv[1]) == "-I")
+			includePaths.push_back(argv[2]);
+		else if(std::string(argv[1]) == "-cache")
+			cacheDir = argv[2];
+		else if(std::string(argv[1]) == "-assets")
+			assetsDir = argv[2];
+		else
+			break;
+		argc -= 2;
+		argv += 2;
+	}
+	if(argc == 3 && std::string(argv[1]) == "-view")
+	{
+		// Show the screen published by another emulator
+
+		DisplayStreamViewer viewer;
+		if(!viewer.connect(argv[2]))
+			return -1;
+		viewer.run();
+	}
+	else if(argc == 3 && std::string(argv[1]) == "-term")
+	{
+		// Run emulator in the terminal
+
+		programFileName = argv[2];
+
+		Emulator emulator;
+
+		if(!emulator.loadAssets(assetsDir))
+			return -1;
+
+		if(!emulator.loadProgram(programFileName, includePaths, cacheDir))
+			return -1;
+		if(!keyScript.empty() && !emulator.startKeyScript(keyScript))
+			return -1;
+		if(!emulator.runTerminal(TerminalRenderer::detectColorMode()))
+			return -1;
+	}
+	else if(argc == 2)
 	{
 		programFileName = argv[1];
 
@@ -30,16 +86,37 @@ int main(int argc, char * argv[])
 
 		Emulator emulator;
 
-		if(!emulator.loadContent())
+		if(!emulator.loadContent(assetsDir))
 			return -1;
 
-		if(emulator.loadProgram(programFileName))
+		if(emulator.loadProgram(programFileName, includePaths, cacheDir))
 		{
+			if(!keyScript.empty() && !emulator.startKeyScript(keyScript))
+				return -1;
+
 			emulator.dumpMemory("dump0");
 			emulator.run();
 			emulator.dumpMemory("dump1");
 		}
 	}
+	else if(argc >= 4 && std::string(argv[1]) == "-build")
+	{
+		// Assemble files in parallel and link them into a program image
+
+		std::string outputFilename = argv[2];
+		std::vector<std::string> inputFilenames(argv + 3, argv + argc);
+		if(!buildProgram(inputFilenames, outputFilename, includePaths))
+			return -1;
+	}
+	else if(argc >= 4 && std::string(argv[1]) == "-link")
+	{
+		// Link object files into a program image
+
+		std::string outputFilename = argv[2];
+		std::vector<std::string> objectFilenames(argv + 3, argv + argc);
+		if(!linkObjects(objectFilenames, outputFilename))
+			return -1;
+	}
 	else if(argc == 4)
 	{
 		std::string cmd = argv[1];
@@ -52,13 +129,43 @@ int main(int argc, char * argv[])
 			if(!convertImageToDASMFont(inputImageFilename, outputFilename))
 				return -1;
 		}
+		else if(cmd == "-stream")
+		{
+			// Run emulator and publish its screen
+
+			std::string socketPath = argv[2];
+			programFileName = argv[3];
+
+			Emulator emulator;
+
+			if(!emulator.loadContent(assetsDir))
+				return -1;
+
+			if(!emulator.loadProgram(programFileName, includePaths, cacheDir))
+				return -1;
+			if(!keyScript.empty() && !emulator.startKeyScript(keyScript))
+				return -1;
+			// About 60 updates per second of guest time
+			if(!emulator.startDisplayStream(socketPath, DCPU_STANDARD_FREQUENCY / 60))
+				return -1;
+			emulator.run();
+		}
 		else if(cmd == "-pp")
 		{
 			// Preprocess a file
 
 			programFileName = argv[2];
 			std::string outputFilename = argv[3];
-			if(!preprocessFile(programFileName, outputFilename))
+			if(!preprocessFile(programFileName, outputFilename, includePaths))
+				return -1;
+		}
+		else if(cmd == "-c")
+		{
+			// Assemble a file into an object file
+
+			programFileName = argv[2];
+			std::string outputFilename = argv[3];
+			if(!assembleObject(programFileName, outputFilename, includePaths))
 				return -1;
 		}
 		else
@@ -67,6 +174,34 @@ int main(int argc, char * argv[])
 			return -1;
 		}
 	}
+	else if(argc == 7 && std::string(argv[1]) == "-capture")
+	{
+		// Run headless and record the screen
+
+		FrameCapture::Format format;
+		if(!FrameCapture::parseFormat(argv[2], format))
+		{
+			std::cout << "E: unknown capture format '" << argv[2] << "'" << std::endl;
+			return -1;
+		}
+		std::string outputFilename = argv[3];
+		u32 interval = std::atol(argv[4]);
+		u32 cycles = std::atol(argv[5]);
+		programFileName = argv[6];
+
+		Emulator emulator;
+
+		if(!emulator.loadAssets(assetsDir))
+			return -1;
+
+		if(!emulator.loadProgram(programFileName, includePaths, cacheDir))
+			return -1;
+		if(!keyScript.empty() && !emulator.startKeyScript(keyScript))
+			return -1;
+		if(!emulator.startCapture(format, outputFilename, interval))
+			return -1;
+		emulator.runHeadless(cycles);
+	}
 	else
 	{
 		// Default: print help